@@ -0,0 +1,186 @@
+#include "asset_pack.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::shared_ptr<const void> mapFile(const std::string &path, size_t &size) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    size = (size_t)info.st_size;
+    void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // マップは閉じても残る / The mapping outlives the descriptor
+    if (data == MAP_FAILED) return nullptr;
+    return std::shared_ptr<const void>(data, [size](const void *p) { munmap((void *)p, size); });
+}
+
+uint64_t fnv1a(const void *data, size_t size, uint64_t hash) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static bool modificationTime(const std::string &path, int64_t &time) {
+    std::error_code ec;
+    const auto writeTime = std::filesystem::last_write_time(path, ec);
+    if (ec) return false;
+    time = (int64_t)writeTime.time_since_epoch().count();
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// パックファイル / Pack file
+// ---------------------------------------------------------------------------
+// [ヘッダ][目次][名前][各ファイルの中身 (16バイト境界)]
+// [header][index][names][file contents, 16-byte aligned]
+
+const char ASSET_PACK_MAGIC[8] = { 'C', 'C', 'P', 'A', 'C', 'K', '0', '1' };
+
+struct AssetPackHeader {
+    char magic[8];
+    uint32_t entryCount;
+    uint32_t namesSize;
+};
+
+struct AssetPackEntry {
+    uint64_t offset;
+    uint64_t size;
+    uint64_t hash;
+    int32_t width;
+    int32_t height;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+};
+
+AssetPack::AssetPack(std::string root)
+    : root_(std::move(root)) {
+}
+
+bool AssetPack::open(const std::string &packFile) {
+    pack_.reset();
+    entries_.clear();
+
+    size_t size = 0;
+    std::shared_ptr<const void> mapped = mapFile(packFile, size);
+    if (!mapped || !modificationTime(packFile, packTime_)) return false;
+
+    const unsigned char *base = (const unsigned char *)mapped.get();
+    AssetPackHeader header;
+    if (size < sizeof(header)) return false;
+    std::memcpy(&header, base, sizeof(header));
+    const size_t indexEnd = sizeof(header) + (size_t)header.entryCount * sizeof(AssetPackEntry);
+    if (std::memcmp(header.magic, ASSET_PACK_MAGIC, sizeof(header.magic)) != 0 ||
+        indexEnd + header.namesSize > size) {
+        fprintf(stderr, "Broken asset pack: %s\n", packFile.c_str());
+        return false;
+    }
+
+    const char *names = (const char *)base + indexEnd;
+    for (uint32_t i = 0; i < header.entryCount; ++i) {
+        AssetPackEntry entry;
+        std::memcpy(&entry, base + sizeof(header) + i * sizeof(AssetPackEntry), sizeof(entry));
+        if (entry.offset + entry.size > size || (uint64_t)entry.nameOffset + entry.nameLength > header.namesSize) {
+            fprintf(stderr, "Broken asset pack: %s\n", packFile.c_str());
+            entries_.clear();
+            return false;
+        }
+        entries_[std::string(names + entry.nameOffset, entry.nameLength)] =
+            { (size_t)entry.offset, (size_t)entry.size, entry.width, entry.height, entry.hash };
+    }
+    pack_ = mapped;
+    return true;
+}
+
+Asset AssetPack::find(const std::string &path) const {
+    const bool underRoot = path.compare(0, root_.size(), root_) == 0;
+    const std::string name = underRoot ? path.substr(root_.size()) : path;
+    const std::string loosePath = underRoot ? path : root_ + path;
+    auto it = entries_.find(name);
+
+    // パックに無いものは個別のファイルから読む. パックより新しいファイルを優先するのは
+    // 開発用のビルド (ASSET_LOOSE_OVERRIDE) だけで, 通常はパックにあるものにファイルの時刻を調べない
+    // Assets missing from the pack come from loose files. Only development builds
+    // (ASSET_LOOSE_OVERRIDE) let a loose file newer than the pack win; otherwise packed
+    // assets are served without touching the file system.
+#ifdef ASSET_LOOSE_OVERRIDE
+    const bool checkLoose = true;
+#else
+    const bool checkLoose = it == entries_.end();
+#endif
+    int64_t looseTime = 0;
+    if (checkLoose && modificationTime(loosePath, looseTime) && (it == entries_.end() || looseTime > packTime_)) {
+        Asset asset;
+        asset.storage = mapFile(loosePath, asset.size);
+        if (asset.storage) {
+            asset.data = (const unsigned char *)asset.storage.get();
+            asset.time = looseTime;
+            return asset;
+        }
+    }
+
+    Asset asset;
+    if (it == entries_.end()) return asset;
+    asset.data = (const unsigned char *)pack_.get() + it->second.offset;
+    asset.size = it->second.size;
+    asset.width = it->second.width;
+    asset.height = it->second.height;
+    asset.time = packTime_;
+    asset.hash = it->second.hash;
+    asset.storage = pack_;
+    return asset;
+}
+
+bool AssetPack::write(const std::string &packFile, const std::vector<Source> &sources) {
+    std::ofstream writer(packFile, std::ios::binary);
+    if (!writer.is_open()) {
+        fprintf(stderr, "Failed to write asset pack: %s\n", packFile.c_str());
+        return false;
+    }
+
+    std::string names;
+    for (const Source &source : sources) names += source.name;
+
+    AssetPackHeader header = {};
+    std::memcpy(header.magic, ASSET_PACK_MAGIC, sizeof(header.magic));
+    header.entryCount = (uint32_t)sources.size();
+    header.namesSize = (uint32_t)names.size();
+
+    // 中身は16バイト境界に置く / Contents start on 16-byte boundaries
+    auto align = [](size_t offset) { return (offset + 15) & ~(size_t)15; };
+    std::vector<AssetPackEntry> index(sources.size());
+    size_t offset = align(sizeof(header) + index.size() * sizeof(AssetPackEntry) + names.size());
+    uint32_t nameOffset = 0;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        const Source &source = sources[i];
+        index[i] = { offset, source.data.size(), source.hash, source.width, source.height, nameOffset,
+                     (uint32_t)source.name.size() };
+        nameOffset += (uint32_t)source.name.size();
+        offset = align(offset + source.data.size());
+    }
+
+    writer.write((const char *)&header, sizeof(header));
+    writer.write((const char *)index.data(), (std::streamsize)(index.size() * sizeof(AssetPackEntry)));
+    writer.write(names.data(), (std::streamsize)names.size());
+    size_t written = sizeof(header) + index.size() * sizeof(AssetPackEntry) + names.size();
+    const char padding[16] = {};
+    for (size_t i = 0; i < sources.size(); ++i) {
+        writer.write(padding, (std::streamsize)(index[i].offset - written));
+        writer.write((const char *)sources[i].data.data(), (std::streamsize)sources[i].data.size());
+        written = index[i].offset + index[i].size;
+    }
+    return (bool)writer;
+}
@@ -0,0 +1,84 @@
+#ifndef _ASSET_PACK_H_
+#define _ASSET_PACK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// アセット1つ. 中身はパックかファイルをマップしたメモリを直接指す (コピーしない)
+// One asset. Its bytes point straight into the mapped pack or file (no copy).
+struct Asset {
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+    int width = 0;       // デコード済みのRGBA8画像なら大きさ / Size if data is a pre-decoded RGBA8 image
+    int height = 0;
+    int64_t time = 0;    // 更新時刻 / Modification time
+    uint64_t hash = 0;   // 元ファイルの内容のハッシュ (0なら未計算) / Hash of the source file (0 if not computed)
+    std::shared_ptr<const void> storage;  // dataを生かしておく / Keeps data alive
+
+    bool valid() const { return data != nullptr; }
+    bool decoded() const { return width > 0 && height > 0; }
+};
+
+// ファイルを読み取り専用でマップする. 失敗したらnullptr
+// Map a file read-only; nullptr on failure
+std::shared_ptr<const void> mapFile(const std::string &path, size_t &size);
+
+// FNV-1a (64ビット) / 64-bit FNV-1a
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+uint64_t fnv1a(const void *data, size_t size, uint64_t hash = FNV_OFFSET_BASIS);
+
+// シェーダや画像を1つにまとめたファイル (pack_assetsで作る). 起動時にマップし, 目次から引く.
+// パックに無いものはルート以下の個別のファイルから読む. 開発用のビルド (ASSET_LOOSE_OVERRIDE) では
+// パックより新しい個別のファイルも優先する
+// Archive of shaders and images built by pack_assets. It is mapped at startup and looked
+// up through its index. Assets missing from the pack come from loose files under the root;
+// development builds (ASSET_LOOSE_OVERRIDE) also prefer a loose file newer than the pack.
+class AssetPack {
+public:
+    // パックに入れる1ファイル (pack_assets用) / One file to store (used by pack_assets)
+    struct Source {
+        std::string name;  // ルートからの相対パス / Path relative to the root
+        std::vector<unsigned char> data;
+        int width = 0;     // デコード済み画像なら大きさ / Size if data is a decoded RGBA8 image
+        int height = 0;
+        uint64_t hash = 0;
+    };
+
+    // rootは個別のファイルが置かれたディレクトリ ('/'で終わる)
+    // root is the directory holding the loose files (ending in '/')
+    explicit AssetPack(std::string root);
+
+    // パックを開く. 無ければfalse (個別のファイルだけを使う)
+    // Open a pack; false if it is missing (only loose files are used then)
+    bool open(const std::string &packFile);
+    bool isOpen() const { return pack_ != nullptr; }
+    int entryCount() const { return (int)entries_.size(); }
+
+    // パスのアセットを返す. ルート以下の絶対パスでも相対パスでもよい. 無ければ無効値.
+    // どのスレッドからでも呼べる
+    // Return the asset at path (absolute under the root, or relative to it); invalid if
+    // there is none. Callable from any thread.
+    Asset find(const std::string &path) const;
+
+    static bool write(const std::string &packFile, const std::vector<Source> &sources);
+
+private:
+    struct Entry {
+        size_t offset;
+        size_t size;
+        int width;
+        int height;
+        uint64_t hash;
+    };
+
+    std::string root_;
+    std::shared_ptr<const void> pack_;
+    int64_t packTime_ = 0;
+    std::unordered_map<std::string, Entry> entries_;
+};
+
+#endif  // _ASSET_PACK_H_
@@ -4,5 +4,7 @@
 static const char *SOURCE_DIRECTORY = "/Users/yuasahayata/Desktop/graphics/src/Final/";
 static const char *SHADER_DIRECTORY = "/Users/yuasahayata/Desktop/graphics/src/Final/shaders/";
 static const char *DATA_DIRECTORY = "/Users/yuasahayata/Desktop/graphics/src/Final/data/";
+static const char *CACHE_DIRECTORY = "/Users/yuasahayata/Desktop/graphics/src/Final/cache/";
+static const char *ASSET_PACK_FILE = "/Users/yuasahayata/Desktop/graphics/src/Final/assets.pack";
 
 #endif  // _COMMON_H_
\ No newline at end of file
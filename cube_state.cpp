@@ -0,0 +1,59 @@
+#include "cube_state.h"
+
+using namespace cube_detail;
+
+static void setVec(int8_t out[3], IVec3 v) {
+    out[0] = (int8_t)(v.x + 1);
+    out[1] = (int8_t)(v.y + 1);
+    out[2] = (int8_t)(v.z + 1);
+}
+
+void CubeState::placements(CubiePlacement out[27]) const {
+    int n = 0;
+    for (int s = 0; s < 8; ++s, ++n) {
+        setVec(out[n].home, CORNER_POS[cp[s]]);
+        setVec(out[n].position, CORNER_POS[s]);
+        out[n].rotation = PLACEMENT_TABLES.corner[cp[s]][s][co[s]];
+    }
+    for (int s = 0; s < 12; ++s, ++n) {
+        setVec(out[n].home, EDGE_POS[ep[s]]);
+        setVec(out[n].position, EDGE_POS[s]);
+        out[n].rotation = PLACEMENT_TABLES.edge[ep[s]][s][eo[s]];
+    }
+    int slotU = 0, slotR = 0;
+    for (int s = 0; s < 6; ++s, ++n) {
+        setVec(out[n].home, CENTER_POS[xp[s]]);
+        setVec(out[n].position, CENTER_POS[s]);
+        out[n].rotation = PLACEMENT_TABLES.center[xp[s]][s][xo[s]];
+        if (xp[s] == 0) slotU = s;
+        if (xp[s] == 1) slotR = s;
+    }
+
+    // 芯はセンターと一体で動くので, U・Rセンターの位置から回転が決まる
+    // The core moves rigidly with the centres, so the U and R centres fix its rotation
+    setVec(out[n].home, IVec3{ 0, 0, 0 });
+    setVec(out[n].position, IVec3{ 0, 0, 0 });
+    out[n].rotation = (uint8_t)findRotation(CENTER_POS[0], CENTER_POS[slotU], CENTER_POS[1], CENTER_POS[slotR]);
+}
+
+CubeMove rotateMove(CubeMove move, int rotation) {
+    const int axis = moveAxis(move);
+    const int layer = moveIndex(move) - 1;
+    const IVec3 axisVec{ axis == 0 ? 1 : 0, axis == 1 ? 1 : 0, axis == 2 ? 1 : 0 };
+    const IVec3 v = ROTATIONS.r[rotation] * axisVec;
+    for (int k = 0; k < 3; ++k) {
+        // 負の軸まわりの回転は, 反対側の層を逆向きに回すのと同じ
+        // A turn about a negative axis is the mirrored layer turned the other way
+        if (v[k] == 1) return makeMove(k, layer + 1, moveClockwise(move));
+        if (v[k] == -1) return makeMove(k, 1 - layer, !moveClockwise(move));
+    }
+    return move;
+}
+
+int inverseRotation(int rotation) {
+    const IMat3 &R = ROTATIONS.r[rotation];
+    for (int i = 0; i < 24; ++i) {
+        if (ROTATIONS.r[i] * R == ROTATIONS.r[0]) return i;
+    }
+    return 0;
+}
@@ -0,0 +1,333 @@
+#ifndef _CUBE_STATE_H_
+#define _CUBE_STATE_H_
+
+#include <cstdint>
+
+// ルービックキューブの論理的な状態 (描画とは独立)
+// 角・辺キューブの置換と向き, センターの置換と向きだけを持ち, 1手の適用は
+// コンパイル時に生成した手の表を引くだけで済む
+// Logical state of the Rubik's cube, independent of rendering. It holds only the
+// corner/edge permutations and orientations plus the centre permutation and
+// orientation, and a move is applied by looking up tables generated at compile time.
+//
+// 座標系は描画側と同じ. x=赤軸, y=緑軸, z=青軸で, 各軸の層番号0〜2は論理位置の座標.
+// 向きの基準としてy軸をU/D (上下), x軸をR/L, z軸をF/Bとみなす.
+// The coordinate frame matches the renderer: x = red axis, y = green axis, z = blue
+// axis, and layer indices 0-2 are logical coordinates. For orientations the y axis is
+// treated as U/D, the x axis as R/L and the z axis as F/B.
+
+// 1手 (軸, 層, 向き) を0〜17の番号で表す. clockwiseは描画側と同じく軸の正方向に+90度
+// A quarter turn (axis, layer index, direction) encoded as 0..17. "clockwise" means
+// +90 degrees about the positive axis, as in the renderer.
+using CubeMove = uint8_t;
+static const int NUM_CUBE_MOVES = 18;
+
+constexpr CubeMove makeMove(int axis, int index, bool clockwise) {
+    return (CubeMove)((axis * 3 + index) * 2 + (clockwise ? 0 : 1));
+}
+constexpr int moveAxis(CubeMove m) { return m / 6; }
+constexpr int moveIndex(CubeMove m) { return (m / 2) % 3; }
+constexpr bool moveClockwise(CubeMove m) { return (m & 1) == 0; }
+constexpr CubeMove inverseMove(CubeMove m) { return (CubeMove)(m ^ 1); }
+
+namespace cube_detail {
+
+struct IVec3 {
+    int x, y, z;
+    constexpr int operator[](int i) const { return i == 0 ? x : (i == 1 ? y : z); }
+};
+constexpr bool operator==(IVec3 a, IVec3 b) { return a.x == b.x && a.y == b.y && a.z == b.z; }
+constexpr IVec3 operator+(IVec3 a, IVec3 b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+constexpr IVec3 cross(IVec3 a, IVec3 b) {
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+constexpr int dot(IVec3 a, IVec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+// 整数の3x3行列 (行優先). 回転群の元はすべて符号付き置換行列
+// Integer 3x3 matrix (row-major); every rotation of the cube is a signed permutation
+struct IMat3 {
+    int m[3][3];
+    constexpr IVec3 operator*(IVec3 v) const {
+        return { m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+                 m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+                 m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z };
+    }
+    constexpr IMat3 operator*(const IMat3 &b) const {
+        IMat3 r{};
+        for (int i = 0; i < 3; ++i)
+            for (int j = 0; j < 3; ++j)
+                for (int k = 0; k < 3; ++k) r.m[i][j] += m[i][k] * b.m[k][j];
+        return r;
+    }
+    constexpr bool operator==(const IMat3 &b) const {
+        for (int i = 0; i < 3; ++i)
+            for (int j = 0; j < 3; ++j)
+                if (m[i][j] != b.m[i][j]) return false;
+        return true;
+    }
+};
+
+// 立方体の回転群 (24元). 0番は恒等変換
+// The 24 rotations of the cube; index 0 is the identity
+struct RotationGroup {
+    IMat3 r[24];
+};
+constexpr RotationGroup genRotations() {
+    const int perms[6][3] = { { 0, 1, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 0, 2, 1 }, { 2, 1, 0 }, { 1, 0, 2 } };
+    RotationGroup g{};
+    int n = 0;
+    for (int p = 0; p < 6; ++p) {
+        for (int s = 0; s < 8; ++s) {
+            const int sign[3] = { (s & 1) ? -1 : 1, (s & 2) ? -1 : 1, (s & 4) ? -1 : 1 };
+            // 偶置換 (p<3) は符号の積が+1, 奇置換は-1のとき行列式が+1
+            // Determinant is +1 when the sign product matches the permutation parity
+            const int parity = p < 3 ? 1 : -1;
+            if (sign[0] * sign[1] * sign[2] != parity) continue;
+            IMat3 m{};
+            for (int row = 0; row < 3; ++row) m.m[row][perms[p][row]] = sign[row];
+            g.r[n++] = m;
+        }
+    }
+    return g;
+}
+inline constexpr RotationGroup ROTATIONS = genRotations();
+
+// 軸まわりの±90度回転 / Quarter turn about a coordinate axis
+constexpr IMat3 quarterTurn(int axis, bool clockwise) {
+    const int s = clockwise ? 1 : -1;
+    if (axis == 0) return IMat3{ { { 1, 0, 0 }, { 0, 0, -s }, { 0, s, 0 } } };
+    if (axis == 1) return IMat3{ { { 0, 0, s }, { 0, 1, 0 }, { -s, 0, 0 } } };
+    return IMat3{ { { 0, -s, 0 }, { s, 0, 0 }, { 0, 0, 1 } } };
+}
+
+// a→a', b→b' を満たす回転の番号 (見つからなければ-1)
+// Index of the rotation mapping a to a2 and b to b2 (-1 if none)
+constexpr int findRotation(IVec3 a, IVec3 a2, IVec3 b, IVec3 b2) {
+    for (int i = 0; i < 24; ++i) {
+        if (ROTATIONS.r[i] * a == a2 && ROTATIONS.r[i] * b == b2) return i;
+    }
+    return -1;
+}
+
+// 各スロットの中心からの位置 (Kociembaの順序: URF, UFL, ULB, UBR, DFR, DLF, DBL, DRB など)
+// Slot positions relative to the core, in Kociemba order
+inline constexpr IVec3 CORNER_POS[8] = {
+    { 1, 1, 1 }, { -1, 1, 1 }, { -1, 1, -1 }, { 1, 1, -1 },
+    { 1, -1, 1 }, { -1, -1, 1 }, { -1, -1, -1 }, { 1, -1, -1 }
+};
+inline constexpr IVec3 EDGE_POS[12] = {
+    { 1, 1, 0 }, { 0, 1, 1 }, { -1, 1, 0 }, { 0, 1, -1 },
+    { 1, -1, 0 }, { 0, -1, 1 }, { -1, -1, 0 }, { 0, -1, -1 },
+    { 1, 0, 1 }, { -1, 0, 1 }, { -1, 0, -1 }, { 1, 0, -1 }
+};
+// センターの順序: U, R, F, D, L, B / Centre order: U, R, F, D, L, B
+inline constexpr IVec3 CENTER_POS[6] = {
+    { 0, 1, 0 }, { 1, 0, 0 }, { 0, 0, 1 }, { 0, -1, 0 }, { -1, 0, 0 }, { 0, 0, -1 }
+};
+
+// 角スロットの3つの面法線. 0番はU/D面で, 残りは行列式が一定になる順 (回転で巡回順が保たれる)
+// The three face normals of a corner slot: index 0 is the U/D face, the others follow
+// an order of constant handedness so that rotations preserve the cyclic order
+constexpr IVec3 cornerNormal(int slot, int k) {
+    const IVec3 p = CORNER_POS[slot];
+    const IVec3 n0{ 0, p.y, 0 };
+    IVec3 n1{ p.x, 0, 0 };
+    IVec3 n2{ 0, 0, p.z };
+    if (dot(n0, cross(n1, n2)) > 0) {
+        const IVec3 t = n1;
+        n1 = n2;
+        n2 = t;
+    }
+    return k == 0 ? n0 : (k == 1 ? n1 : n2);
+}
+
+// 辺スロットの2つの面法線. 0番はU/D面, 無ければF/B面 (Kociembaの向きの定義)
+// The two face normals of an edge slot: index 0 is the U/D face, or F/B for middle edges
+constexpr IVec3 edgeNormal(int slot, int k) {
+    const IVec3 p = EDGE_POS[slot];
+    const IVec3 n0 = p.y != 0 ? IVec3{ 0, p.y, 0 } : IVec3{ 0, 0, p.z };
+    const IVec3 n1{ p.x - n0.x, p.y - n0.y, p.z - n0.z };
+    return k == 0 ? n0 : n1;
+}
+
+// センタースロットの基準となる接線方向と, それを面法線まわりにk回+90度回したもの
+// Reference tangent of a centre slot, turned k quarter turns about the face normal
+constexpr IVec3 centerTangent(int slot, int k) {
+    const IVec3 n = CENTER_POS[slot];
+    IVec3 t = n.y != 0 ? IVec3{ 0, 0, 1 } : IVec3{ 0, 1, 0 };
+    for (int i = 0; i < k; ++i) t = cross(n, t);
+    return t;
+}
+
+template <int N>
+constexpr int findSlot(const IVec3 (&slots)[N], IVec3 p) {
+    for (int i = 0; i < N; ++i) {
+        if (slots[i] == p) return i;
+    }
+    return -1;
+}
+
+// 1手の表. 移動先スロットdについて, 移動元スロットと向きの増分を持つ
+// Table for one move: for each destination slot, the source slot and orientation delta
+struct MoveTable {
+    uint8_t cornerSrc[8], cornerTwist[8];
+    uint8_t edgeSrc[12], edgeFlip[12];
+    uint8_t centerSrc[6], centerTurn[6];
+};
+
+constexpr MoveTable genMoveTable(CubeMove move) {
+    const int axis = moveAxis(move);
+    const int layer = moveIndex(move) - 1;
+    const IMat3 R = quarterTurn(axis, moveClockwise(move));
+    MoveTable t{};
+    for (int s = 0; s < 8; ++s) {
+        t.cornerSrc[s] = (uint8_t)s;
+        t.cornerTwist[s] = 0;
+    }
+    for (int s = 0; s < 12; ++s) {
+        t.edgeSrc[s] = (uint8_t)s;
+        t.edgeFlip[s] = 0;
+    }
+    for (int s = 0; s < 6; ++s) {
+        t.centerSrc[s] = (uint8_t)s;
+        t.centerTurn[s] = 0;
+    }
+    for (int s = 0; s < 8; ++s) {
+        if (CORNER_POS[s][axis] != layer) continue;
+        const int d = findSlot(CORNER_POS, R * CORNER_POS[s]);
+        t.cornerSrc[d] = (uint8_t)s;
+        const IVec3 n = R * cornerNormal(s, 0);
+        for (int k = 0; k < 3; ++k) {
+            if (cornerNormal(d, k) == n) t.cornerTwist[d] = (uint8_t)k;
+        }
+    }
+    for (int s = 0; s < 12; ++s) {
+        if (EDGE_POS[s][axis] != layer) continue;
+        const int d = findSlot(EDGE_POS, R * EDGE_POS[s]);
+        t.edgeSrc[d] = (uint8_t)s;
+        t.edgeFlip[d] = edgeNormal(d, 0) == R * edgeNormal(s, 0) ? 0 : 1;
+    }
+    for (int s = 0; s < 6; ++s) {
+        if (CENTER_POS[s][axis] != layer) continue;
+        const int d = findSlot(CENTER_POS, R * CENTER_POS[s]);
+        t.centerSrc[d] = (uint8_t)s;
+        const IVec3 tangent = R * centerTangent(s, 0);
+        for (int k = 0; k < 4; ++k) {
+            if (centerTangent(d, k) == tangent) t.centerTurn[d] = (uint8_t)k;
+        }
+    }
+    return t;
+}
+
+struct MoveTables {
+    MoveTable m[NUM_CUBE_MOVES];
+};
+constexpr MoveTables genMoveTables() {
+    MoveTables t{};
+    for (int i = 0; i < NUM_CUBE_MOVES; ++i) t.m[i] = genMoveTable((CubeMove)i);
+    return t;
+}
+inline constexpr MoveTables MOVE_TABLES = genMoveTables();
+
+// 描画用: 初期スロットh のキューブが スロットs に向きkで入っているときの回転の番号
+// For rendering: rotation index of the cubie from home slot h sitting in slot s with orientation k
+struct PlacementTables {
+    uint8_t corner[8][8][3];
+    uint8_t edge[12][12][2];
+    uint8_t center[6][6][4];
+};
+constexpr PlacementTables genPlacementTables() {
+    PlacementTables t{};
+    for (int h = 0; h < 8; ++h)
+        for (int s = 0; s < 8; ++s)
+            for (int k = 0; k < 3; ++k)
+                t.corner[h][s][k] = (uint8_t)findRotation(CORNER_POS[h], CORNER_POS[s], cornerNormal(h, 0), cornerNormal(s, k));
+    for (int h = 0; h < 12; ++h)
+        for (int s = 0; s < 12; ++s)
+            for (int k = 0; k < 2; ++k)
+                t.edge[h][s][k] = (uint8_t)findRotation(EDGE_POS[h], EDGE_POS[s], edgeNormal(h, 0), edgeNormal(s, k));
+    for (int h = 0; h < 6; ++h)
+        for (int s = 0; s < 6; ++s)
+            for (int k = 0; k < 4; ++k)
+                t.center[h][s][k] = (uint8_t)findRotation(CENTER_POS[h], CENTER_POS[s], centerTangent(h, 0), centerTangent(s, k));
+    return t;
+}
+inline constexpr PlacementTables PLACEMENT_TABLES = genPlacementTables();
+
+}  // namespace cube_detail
+
+// 小立方体1個の配置 (描画側が読む). 座標は論理位置 (0〜2)
+// Placement of one cubie as read by the renderer; coordinates are logical (0-2)
+struct CubiePlacement {
+    int8_t home[3];      // 揃った状態での位置 / Position in the solved state
+    int8_t position[3];  // 現在の位置 / Current position
+    uint8_t rotation;    // 回転群の元の番号 (cubeRotation()で行列を得る) / Rotation group index
+};
+
+struct CubeState {
+    uint8_t cp[8], co[8];    // 角: スロットにある角キューブの番号と向き (0〜2) / Corners
+    uint8_t ep[12], eo[12];  // 辺: スロットにある辺キューブの番号と向き (0〜1) / Edges
+    uint8_t xp[6], xo[6];    // センター: 番号と向き (0〜3, 1/4回転単位) / Centres
+
+    // 揃った状態 / The solved state
+    static constexpr CubeState solved() {
+        CubeState s{};
+        for (int i = 0; i < 8; ++i) s.cp[i] = (uint8_t)i;
+        for (int i = 0; i < 12; ++i) s.ep[i] = (uint8_t)i;
+        for (int i = 0; i < 6; ++i) s.xp[i] = (uint8_t)i;
+        return s;
+    }
+
+    // 1手を適用する (表引きのみ) / Apply one move (table lookups only)
+    constexpr void apply(CubeMove move) {
+        const cube_detail::MoveTable &t = cube_detail::MOVE_TABLES.m[move];
+        CubeState r{};
+        for (int i = 0; i < 8; ++i) {
+            r.cp[i] = cp[t.cornerSrc[i]];
+            r.co[i] = (uint8_t)((co[t.cornerSrc[i]] + t.cornerTwist[i]) % 3);
+        }
+        for (int i = 0; i < 12; ++i) {
+            r.ep[i] = ep[t.edgeSrc[i]];
+            r.eo[i] = (uint8_t)(eo[t.edgeSrc[i]] ^ t.edgeFlip[i]);
+        }
+        for (int i = 0; i < 6; ++i) {
+            r.xp[i] = xp[t.centerSrc[i]];
+            r.xo[i] = (uint8_t)((xo[t.centerSrc[i]] + t.centerTurn[i]) & 3);
+        }
+        *this = r;
+    }
+
+    // 手順をまとめて適用する / Apply a sequence of moves
+    constexpr void apply(const CubeMove *moves, int count) {
+        for (int i = 0; i < count; ++i) apply(moves[i]);
+    }
+
+    constexpr bool operator==(const CubeState &o) const {
+        for (int i = 0; i < 8; ++i)
+            if (cp[i] != o.cp[i] || co[i] != o.co[i]) return false;
+        for (int i = 0; i < 12; ++i)
+            if (ep[i] != o.ep[i] || eo[i] != o.eo[i]) return false;
+        for (int i = 0; i < 6; ++i)
+            if (xp[i] != o.xp[i] || xo[i] != o.xo[i]) return false;
+        return true;
+    }
+
+    // 全ての小立方体 (角8, 辺12, センター6, 芯1) の配置を求める
+    // Compute the placement of all 27 cubies (8 corners, 12 edges, 6 centres and the core)
+    void placements(CubiePlacement out[27]) const;
+};
+
+// 回転群の元 rotation で手を写す (軸を回転させた手. 手順の共役に使う)
+// Map a move through a rotation of the whole cube (conjugates move sequences)
+CubeMove rotateMove(CubeMove move, int rotation);
+
+// 逆回転の番号 / Index of the inverse rotation
+int inverseRotation(int rotation);
+
+// 回転群の元を3x3の整数行列 (行優先) として取り出す
+// Fetch a rotation group element as an integer 3x3 matrix (row-major)
+inline const int (&cubeRotation(int index))[3][3] {
+    return cube_detail::ROTATIONS.r[index].m;
+}
+
+#endif  // _CUBE_STATE_H_
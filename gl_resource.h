@@ -0,0 +1,111 @@
+#ifndef _GL_RESOURCE_H_
+#define _GL_RESOURCE_H_
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <glad/gl.h>
+
+// OpenGLのオブジェクト1つを所有するハンドル (ムーブのみ可能)
+// 破棄・reset()・別の値の代入で古いオブジェクトを削除するので, 作り直しても漏れない.
+// GLコンテキストが無くなった後にデストラクタが走っても, 先にreset()しておけば何も呼ばない
+// Move-only handle owning one OpenGL object. Destruction, reset() and assignment delete
+// the previous object, so re-creating never leaks. Handles reset before the context goes
+// away are inert, which makes them safe as globals.
+template <typename Traits>
+class GLHandle {
+public:
+    GLHandle() = default;
+    explicit GLHandle(GLuint id)
+        : id_(id) {
+    }
+    ~GLHandle() { reset(); }
+
+    GLHandle(const GLHandle &) = delete;
+    GLHandle &operator=(const GLHandle &) = delete;
+    GLHandle(GLHandle &&other) noexcept
+        : id_(other.release()) {
+    }
+    GLHandle &operator=(GLHandle &&other) noexcept {
+        if (this != &other) reset(other.release());
+        return *this;
+    }
+
+    // 新しいオブジェクトを作る / Create a new object
+    static GLHandle create() { return GLHandle(Traits::create()); }
+
+    GLuint get() const { return id_; }
+    operator GLuint() const { return id_; }
+    explicit operator bool() const { return id_ != 0; }
+
+    // 所有しているオブジェクトを削除し, 代わりにidを持つ
+    // Delete the owned object and take ownership of id instead
+    void reset(GLuint id = 0) {
+        if (id_ != 0 && id_ != id) Traits::destroy(id_);
+        id_ = id;
+    }
+    // 所有権を手放してidを返す / Give up ownership and return the id
+    GLuint release() {
+        const GLuint id = id_;
+        id_ = 0;
+        return id;
+    }
+
+private:
+    GLuint id_ = 0;
+};
+
+struct GLTextureTraits {
+    static GLuint create() { GLuint id = 0; glGenTextures(1, &id); return id; }
+    static void destroy(GLuint id) { glDeleteTextures(1, &id); }
+};
+struct GLBufferTraits {
+    static GLuint create() { GLuint id = 0; glGenBuffers(1, &id); return id; }
+    static void destroy(GLuint id) { glDeleteBuffers(1, &id); }
+};
+struct GLVertexArrayTraits {
+    static GLuint create() { GLuint id = 0; glGenVertexArrays(1, &id); return id; }
+    static void destroy(GLuint id) { glDeleteVertexArrays(1, &id); }
+};
+struct GLProgramTraits {
+    static GLuint create() { return glCreateProgram(); }
+    static void destroy(GLuint id) { glDeleteProgram(id); }
+};
+
+using GLTexture = GLHandle<GLTextureTraits>;
+using GLBuffer = GLHandle<GLBufferTraits>;
+using GLVertexArray = GLHandle<GLVertexArrayTraits>;
+using GLProgram = GLHandle<GLProgramTraits>;
+
+// 画像などのアセットから作ったGLオブジェクトを名前で管理するクラス
+// 最初に要求された時だけ読み込み, 以降は同じものを返す (NormalモードとArtモードで共有する)
+// Keeps GL objects built from assets under a name. Each one is loaded the first time
+// it is requested and shared afterwards (e.g. between Normal and Art modes).
+class ResourceManager {
+public:
+    using TextureLoader = std::function<GLTexture()>;
+
+    // keyのテクスチャを返す. まだ無ければloaderで作る
+    // Return the texture for key, creating it with loader on first use
+    GLuint texture(const std::string &key, const TextureLoader &loader) {
+        auto it = textures_.find(key);
+        if (it == textures_.end()) {
+            it = textures_.emplace(key, loader()).first;
+        }
+        return it->second;
+    }
+
+    bool hasTexture(const std::string &key) const { return textures_.count(key) != 0; }
+    int textureCount() const { return (int)textures_.size(); }
+
+    // 全て削除する (GLコンテキストがある間に呼ぶ)
+    // Delete everything (call while the GL context is alive)
+    void clear() { textures_.clear(); }
+
+private:
+    std::unordered_map<std::string, GLTexture> textures_;
+};
+
+#endif  // _GL_RESOURCE_H_
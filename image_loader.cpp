@@ -0,0 +1,127 @@
+#include "image_loader.h"
+
+#include <algorithm>
+
+#include "stb_image.h"
+
+ImageLoader::ImageLoader(int numThreads)
+    : numThreads_(numThreads > 0 ? numThreads : (int)std::max(1u, std::thread::hardware_concurrency())) {
+}
+
+ImageLoader::~ImageLoader() {
+    shutdown();
+}
+
+void ImageLoader::startWorkers() {
+    // 最初に処理が積まれた時に起動する / Started when the first work item is queued
+    if (!workers_.empty()) return;
+    stopping_ = false;
+    for (int i = 0; i < numThreads_; ++i) {
+        workers_.emplace_back(&ImageLoader::workerLoop, this);
+    }
+}
+
+void ImageLoader::load(const std::string &path, Callback callback) {
+    submit([path]() { return decodeFile(path); }, std::move(callback));
+}
+
+void ImageLoader::submit(Job job, Callback callback) {
+    submitTask<LoadedImage>(std::move(job), std::move(callback));
+}
+
+void ImageLoader::enqueue(std::function<void()> work, std::function<void()> deliver) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        startWorkers();
+        queued_.push_back({ std::move(work), std::move(deliver) });
+        ++pending_;
+    }
+    wake_.notify_one();
+}
+
+void ImageLoader::workerLoop() {
+    for (;;) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this]() { return stopping_ || !queued_.empty(); });
+            if (stopping_) return;
+            task = std::move(queued_.front());
+            queued_.pop_front();
+        }
+
+        task.work();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            // 止める途中に終わった結果は捨てる / Results finishing during shutdown are dropped
+            --pending_;
+            return;
+        }
+        finished_.push_back(std::move(task));
+    }
+}
+
+int ImageLoader::poll() {
+    std::deque<Task> done;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done.swap(finished_);
+    }
+    for (Task &task : done) {
+        --pending_;
+        task.deliver();
+    }
+    return (int)done.size();
+}
+
+void ImageLoader::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        pending_ -= (int)(queued_.size() + finished_.size());
+        queued_.clear();
+        finished_.clear();
+    }
+    wake_.notify_all();
+    for (std::thread &worker : workers_) worker.join();
+    workers_.clear();
+}
+
+LoadedImage ImageLoader::decodeFile(const std::string &path) {
+    LoadedImage image;
+    int channels = 0;
+    unsigned char *data = stbi_load(path.c_str(), &image.width, &image.height, &channels, STBI_rgb_alpha);
+    if (!data) return LoadedImage();
+    image.pixels.assign(data, data + (size_t)image.width * image.height * 4);
+    stbi_image_free(data);
+    return image;
+}
+
+LoadedImage ImageLoader::decodeAsset(const Asset &asset) {
+    LoadedImage image;
+    if (!asset.valid()) return image;
+    if (asset.decoded()) {
+        image.width = asset.width;
+        image.height = asset.height;
+        image.pixels.assign(asset.data, asset.data + asset.size);
+        return image;
+    }
+    int channels = 0;
+    unsigned char *data = stbi_load_from_memory(asset.data, (int)asset.size, &image.width, &image.height, &channels, STBI_rgb_alpha);
+    if (!data) return LoadedImage();
+    image.pixels.assign(data, data + (size_t)image.width * image.height * 4);
+    stbi_image_free(data);
+    return image;
+}
+
+bool ImageLoader::imageInfo(const Asset &asset, int &width, int &height) {
+    if (!asset.valid()) return false;
+    if (asset.decoded()) {
+        width = asset.width;
+        height = asset.height;
+        return true;
+    }
+    int channels = 0;
+    return stbi_info_from_memory(asset.data, (int)asset.size, &width, &height, &channels) != 0;
+}
@@ -0,0 +1,101 @@
+#ifndef _IMAGE_LOADER_H_
+#define _IMAGE_LOADER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "asset_pack.h"
+
+// RGBA8の画像 (上の行から) / RGBA8 image (top row first)
+struct LoadedImage {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+
+    bool valid() const { return !pixels.empty(); }
+};
+
+// 画像の読み込みとデコードをスレッドプールで並列に行うクラス
+// 重い処理 (デコード, リサンプルなど) はワーカースレッドで行い, 結果はpoll()を呼んだ
+// スレッド (GLスレッド) のコールバックに渡すので, テクスチャの転送はそこで行える
+// Thread pool that reads and decodes images in parallel. The heavy work (decoding,
+// resampling, ...) runs on worker threads; finished images are handed to callbacks on
+// the thread calling poll() (the GL thread), where they can be uploaded.
+class ImageLoader {
+public:
+    // ワーカースレッドで実行する処理 / Work run on a worker thread
+    using Job = std::function<LoadedImage()>;
+    // GLスレッドで呼ばれる. 失敗した時はimage.valid()がfalse
+    // Called on the GL thread; image.valid() is false on failure
+    using Callback = std::function<void(LoadedImage &image)>;
+
+    // numThreads <= 0 ならコア数 / numThreads <= 0 uses the number of cores
+    explicit ImageLoader(int numThreads = 0);
+    ~ImageLoader();
+
+    ImageLoader(const ImageLoader &) = delete;
+    ImageLoader &operator=(const ImageLoader &) = delete;
+
+    // ファイルを読んでRGBA8にデコードする / Read a file and decode it to RGBA8
+    void load(const std::string &path, Callback callback);
+    // 任意の処理を積む / Queue arbitrary work
+    void submit(Job job, Callback callback);
+
+    // 画像以外を返す処理を積む. resultはjobの戻り値で, GLスレッドでcallbackに渡される
+    // Queue work producing something other than a LoadedImage; its result is handed to callback on the GL thread
+    template <typename Result>
+    void submitTask(std::function<Result()> job, std::function<void(Result &result)> callback) {
+        auto result = std::make_shared<Result>();
+        enqueue([job, result]() { *result = job(); },
+                [callback, result]() { if (callback) callback(*result); });
+    }
+
+    // 終わった処理のコールバックを呼ぶ. 毎フレーム呼ぶ (待たない). 戻り値は呼んだ数
+    // Deliver finished work to its callbacks; call once per frame (never blocks). Returns the number delivered
+    int poll();
+
+    // まだコールバックを呼んでいない処理の数 / Work items whose callbacks have not run yet
+    int pending() const { return pending_.load(); }
+
+    // 始まっていない処理を捨て, ワーカーを止める / Drop work that has not started and stop the workers
+    void shutdown();
+
+    // ファイルをRGBA8にデコードする (どのスレッドからでも呼べる)
+    // Decode a file to RGBA8 (callable from any thread)
+    static LoadedImage decodeFile(const std::string &path);
+    // アセットをRGBA8にする. パックにデコード済みで入っていればコピーするだけ
+    // Decode an asset to RGBA8; pre-decoded pack entries are just copied
+    static LoadedImage decodeAsset(const Asset &asset);
+    // 画像の大きさだけを調べる (デコードしない) / Read only the image size (no decoding)
+    static bool imageInfo(const Asset &asset, int &width, int &height);
+
+private:
+    // workはワーカースレッドで, deliverはpoll()で呼ばれる
+    // work runs on a worker thread, deliver from poll()
+    struct Task {
+        std::function<void()> work;
+        std::function<void()> deliver;
+    };
+
+    void enqueue(std::function<void()> work, std::function<void()> deliver);
+    void startWorkers();
+    void workerLoop();
+
+    int numThreads_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<Task> queued_;    // 未着手 / Not started yet
+    std::deque<Task> finished_;  // コールバック待ち / Waiting for their callbacks
+    bool stopping_ = false;
+    std::atomic<int> pending_{ 0 };
+};
+
+#endif  // _IMAGE_LOADER_H_
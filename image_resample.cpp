@@ -0,0 +1,163 @@
+#include "image_resample.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+std::vector<unsigned char> resampleImage(const unsigned char *src, int srcWidth, int srcHeight, int dstWidth, int dstHeight) {
+    std::vector<unsigned char> dst((size_t)dstWidth * dstHeight * 4);
+    const float sx = (float)srcWidth / dstWidth;
+    const float sy = (float)srcHeight / dstHeight;
+    for (int y = 0; y < dstHeight; ++y) {
+        const float fy = std::clamp((y + 0.5f) * sy - 0.5f, 0.0f, (float)(srcHeight - 1));
+        const int y0 = (int)fy;
+        const int y1 = std::min(y0 + 1, srcHeight - 1);
+        const float ty = fy - y0;
+        for (int x = 0; x < dstWidth; ++x) {
+            const float fx = std::clamp((x + 0.5f) * sx - 0.5f, 0.0f, (float)(srcWidth - 1));
+            const int x0 = (int)fx;
+            const int x1 = std::min(x0 + 1, srcWidth - 1);
+            const float tx = fx - x0;
+            for (int c = 0; c < 4; ++c) {
+                const float p00 = src[((size_t)y0 * srcWidth + x0) * 4 + c];
+                const float p01 = src[((size_t)y0 * srcWidth + x1) * 4 + c];
+                const float p10 = src[((size_t)y1 * srcWidth + x0) * 4 + c];
+                const float p11 = src[((size_t)y1 * srcWidth + x1) * 4 + c];
+                const float top = p00 + (p01 - p00) * tx;
+                const float bottom = p10 + (p11 - p10) * tx;
+                dst[((size_t)y * dstWidth + x) * 4 + c] = (unsigned char)(top + (bottom - top) * ty + 0.5f);
+            }
+        }
+    }
+    return dst;
+}
+
+// ---------------------------------------------------------------------------
+// 箱フィルタ / Box filter
+// ---------------------------------------------------------------------------
+// 縦と横に分けて足す. 縦はfactorY行をチャンネルごとの32ビットの列の合計に16バイトずつ足し,
+// 横は1画素 (RGBA) をSIMDレジスタの4レーンに載せてfactorX画素ずつ足し, 4画素ずつ書き出す.
+// どちらも出力画素をまたいで進むので, 倍率が2や3でもSIMDで動く
+// The filter is separable. Vertically, factorY rows are added into per-channel 32-bit
+// column sums 16 bytes at a time; horizontally, each RGBA pixel fills the four lanes of a
+// SIMD register, factorX of them are added and results are written four pixels at a time.
+// Both passes run across output pixels, so small factors such as 2 or 3 stay vectorised.
+
+// 縦: 1行分のバイトをsumsに足す / Vertical: add one row's bytes to sums
+static void accumulateColumns(const unsigned char *src, int count, uint32_t *sums) {
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= count; i += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        const __m128i lo = _mm_unpacklo_epi8(v, zero);
+        const __m128i hi = _mm_unpackhi_epi8(v, zero);
+        __m128i *s = (__m128i *)(sums + i);
+        _mm_storeu_si128(s + 0, _mm_add_epi32(_mm_loadu_si128(s + 0), _mm_unpacklo_epi16(lo, zero)));
+        _mm_storeu_si128(s + 1, _mm_add_epi32(_mm_loadu_si128(s + 1), _mm_unpackhi_epi16(lo, zero)));
+        _mm_storeu_si128(s + 2, _mm_add_epi32(_mm_loadu_si128(s + 2), _mm_unpacklo_epi16(hi, zero)));
+        _mm_storeu_si128(s + 3, _mm_add_epi32(_mm_loadu_si128(s + 3), _mm_unpackhi_epi16(hi, zero)));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 16 <= count; i += 16) {
+        const uint8x16_t v = vld1q_u8(src + i);
+        const uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+        const uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+        vst1q_u32(sums + i + 0, vaddw_u16(vld1q_u32(sums + i + 0), vget_low_u16(lo)));
+        vst1q_u32(sums + i + 4, vaddw_u16(vld1q_u32(sums + i + 4), vget_high_u16(lo)));
+        vst1q_u32(sums + i + 8, vaddw_u16(vld1q_u32(sums + i + 8), vget_low_u16(hi)));
+        vst1q_u32(sums + i + 12, vaddw_u16(vld1q_u32(sums + i + 12), vget_high_u16(hi)));
+    }
+#endif
+    // 残り (SIMDが無ければ全部) / The rest (everything without SIMD)
+    for (; i < count; ++i) sums[i] += src[i];
+}
+
+// 横: factor画素ずつの列の合計を平均にして書き出す / Horizontal: average each factor-pixel run of column sums
+static void resolveRow(const uint32_t *sums, int dstWidth, int factor, int count, unsigned char *dst) {
+    const float scale = 1.0f / count;
+    int x = 0;
+#if defined(__SSE2__)
+    const __m128 scale4 = _mm_set1_ps(scale);
+    const __m128 half4 = _mm_set1_ps(0.5f);
+    auto average = [&](int px) {
+        const __m128i *p = (const __m128i *)(sums + (size_t)px * factor * 4);
+        __m128i sum = _mm_loadu_si128(p);
+        for (int i = 1; i < factor; ++i) sum = _mm_add_epi32(sum, _mm_loadu_si128(p + i));
+        return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(sum), scale4), half4));
+    };
+    for (; x + 4 <= dstWidth; x += 4) {
+        const __m128i lo = _mm_packs_epi32(average(x), average(x + 1));
+        const __m128i hi = _mm_packs_epi32(average(x + 2), average(x + 3));
+        _mm_storeu_si128((__m128i *)(dst + x * 4), _mm_packus_epi16(lo, hi));
+    }
+#elif defined(__ARM_NEON)
+    const float32x4_t half4 = vdupq_n_f32(0.5f);
+    auto average = [&](int px) {
+        const uint32_t *p = sums + (size_t)px * factor * 4;
+        uint32x4_t sum = vld1q_u32(p);
+        for (int i = 1; i < factor; ++i) sum = vaddq_u32(sum, vld1q_u32(p + i * 4));
+        return vmovn_u32(vcvtq_u32_f32(vaddq_f32(vmulq_n_f32(vcvtq_f32_u32(sum), scale), half4)));
+    };
+    for (; x + 4 <= dstWidth; x += 4) {
+        const uint8x8_t lo = vqmovn_u16(vcombine_u16(average(x), average(x + 1)));
+        const uint8x8_t hi = vqmovn_u16(vcombine_u16(average(x + 2), average(x + 3)));
+        vst1q_u8(dst + x * 4, vcombine_u8(lo, hi));
+    }
+#endif
+    for (; x < dstWidth; ++x) {
+        const uint32_t *p = sums + (size_t)x * factor * 4;
+        for (int c = 0; c < 4; ++c) {
+            uint32_t sum = 0;
+            for (int i = 0; i < factor; ++i) sum += p[i * 4 + c];
+            dst[x * 4 + c] = (unsigned char)std::min(255.0f, sum * scale + 0.5f);
+        }
+    }
+}
+
+std::vector<unsigned char> boxDownscale(const unsigned char *src, int srcWidth, int srcHeight, int factorX, int factorY) {
+    factorX = std::max(1, factorX);
+    factorY = std::max(1, factorY);
+    const int dstWidth = std::max(1, srcWidth / factorX);
+    const int dstHeight = std::max(1, srcHeight / factorY);
+    factorX = std::min(factorX, srcWidth);
+    factorY = std::min(factorY, srcHeight);
+
+    // 使う列 (右端の余りを除く) の合計 / Sums for the columns in use (leftover right edge excluded)
+    const int rowBytes = dstWidth * factorX * 4;
+    std::vector<unsigned char> dst((size_t)dstWidth * dstHeight * 4);
+    std::vector<uint32_t> sums((size_t)rowBytes);
+    for (int y = 0; y < dstHeight; ++y) {
+        std::fill(sums.begin(), sums.end(), 0u);
+        for (int j = 0; j < factorY; ++j) {
+            accumulateColumns(src + ((size_t)y * factorY + j) * srcWidth * 4, rowBytes, sums.data());
+        }
+        resolveRow(sums.data(), dstWidth, factorX, factorX * factorY, dst.data() + (size_t)y * dstWidth * 4);
+    }
+    return dst;
+}
+
+void resizeImage(LoadedImage &image, int width, int height) {
+    if (!image.valid() || (image.width == width && image.height == height)) return;
+
+    // バイリニアは2倍より縮めると画素を飛ばすので, 先に箱フィルタで近づける
+    // Bilinear skips pixels when shrinking by more than 2x, so box-filter most of the way first
+    const int factorX = std::max(1, image.width / width);
+    const int factorY = std::max(1, image.height / height);
+    if (factorX > 1 || factorY > 1) {
+        image.pixels = boxDownscale(image.pixels.data(), image.width, image.height, factorX, factorY);
+        image.width = std::max(1, image.width / factorX);
+        image.height = std::max(1, image.height / factorY);
+    }
+    if (image.width != width || image.height != height) {
+        image.pixels = resampleImage(image.pixels.data(), image.width, image.height, width, height);
+        image.width = width;
+        image.height = height;
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef _IMAGE_RESAMPLE_H_
+#define _IMAGE_RESAMPLE_H_
+
+#include <vector>
+
+#include "image_loader.h"
+
+// RGBA画像をバイリニア補間で指定サイズにリサンプルする
+// Resample an RGBA image to the given size with bilinear filtering
+std::vector<unsigned char> resampleImage(const unsigned char *src, int srcWidth, int srcHeight, int dstWidth, int dstHeight);
+
+// 横factorX, 縦factorY画素ずつの平均で縮小する (端の余りは捨てる). SSE2/NEONがあれば使う
+// Shrink an RGBA image by averaging factorX x factorY pixel boxes (leftover edge pixels
+// are dropped). Uses SSE2 or NEON when available.
+std::vector<unsigned char> boxDownscale(const unsigned char *src, int srcWidth, int srcHeight, int factorX, int factorY);
+
+// 画像を指定サイズにする. 2倍以上大きければまず整数倍の箱フィルタで縮め,
+// 残り (2倍未満) をバイリニアで合わせる
+// Resize an image to the given size. Anything at least twice too large is first shrunk
+// by a whole-number box filter; the remaining (under 2x) step is bilinear.
+void resizeImage(LoadedImage &image, int width, int height);
+
+#endif  // _IMAGE_RESAMPLE_H_
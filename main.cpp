@@ -1,11 +1,14 @@
 #include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <limits>
 #include <random>
+#include <thread>
 
 #define GLAD_GL_IMPLEMENTATION
 #include <glad/gl.h>
@@ -27,13 +30,41 @@
 // 画像のパスなどが書かれた設定ファイル
 // Config file storing image locations etc.
 #include "common.h"
+#include "gl_resource.h"
+#include "shader_program.h"
+#include "cube_state.h"
+#include "solver.h"
+#include "move_queue.h"
+#include "scrambler.h"
+#include "readback.h"
+#include "sprite_batch.h"
+#include "image_loader.h"
+#include "texture_cache.h"
+#include "image_resample.h"
+#include "asset_pack.h"
+#include "program_cache.h"
 
 static int WIN_WIDTH = 500;                      // ウィンドウの幅 / Window width
 static int WIN_HEIGHT = 500;                     // ウィンドウの高さ / Window height
 static const char *WIN_TITLE = "OpenGL Course";  // ウィンドウのタイトル / Window title
 
+// カメラの位置と縦の画角 / Camera position and vertical field of view
+static const glm::vec3 CAMERA_EYE = glm::vec3(3.0f, 4.0f, 5.0f);
+static const float CAMERA_FOVY = glm::radians(45.0f);
+
 static  bool ArtMode = true;
+
+// 1手の回転アニメーションの長さ (秒) と補間の種類
+// Duration of one layer turn (seconds) and its easing curve
+enum TurnEasing { EASE_LINEAR, EASE_IN_OUT, EASE_OUT };
+static float turnDuration = 0.5f;
+static TurnEasing turnEasing = EASE_IN_OUT;
+// 追いつきモード: 入力が溜まったら1手の時間を縮め, 表示の遅れをmaxInputLag秒以内に抑える
+// Catch-up mode: shorten turns while input is queued so the display lags at most maxInputLag seconds
+static bool catchUpMode = true;
+static float maxInputLag = 0.5f;
 const std::string SETTING_IMAGE = std::string(DATA_DIRECTORY) + "setting.png"; // 設定画面の画像パス / Path to the settings image
+static const std::string SOLVER_TABLE_FILE = std::string(CACHE_DIRECTORY) + "solver_tables.bin";
 static const std::string TEX_FILE = std::string(DATA_DIRECTORY) + "yu.png"; 
 const std::string TEX_FILES[6] = {
     std::string(DATA_DIRECTORY) + "face0.png", // +X
@@ -43,25 +74,45 @@ const std::string TEX_FILES[6] = {
     std::string(DATA_DIRECTORY) + "face4.png", // +Z
     std::string(DATA_DIRECTORY) + "face5.png"  // -Z
 };
-GLuint textureIds[6];
+GLuint faceArrayTexId = 0;  // 6面の画像をレイヤーとして持つ配列テクスチャ / Array texture holding the 6 face images as layers
 
 // シェーダ言語のソースファイル / Shader source files
 static std::string VERT_SHADER_FILE = std::string(SHADER_DIRECTORY) + "render.vert";
 static std::string FRAG_SHADER_FILE = std::string(SHADER_DIRECTORY) + "render.frag";
+// リンク済みプログラムのバイナリの置き場所 / Where linked program binaries are stored
+static ProgramCache programCache(std::string(CACHE_DIRECTORY) + "programs/");
+
+// 単精度浮動小数点数を半精度に変換する (非正規化数は0に, 範囲外は無限大に丸める)
+// Convert a float to half precision (denormals flush to zero, out-of-range values become infinity)
+static GLhalf toHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000u;
+    const int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    const uint32_t mantissa = bits & 0x7fffffu;
+    if (exponent <= 0) return (GLhalf)sign;
+    if (exponent >= 31) return (GLhalf)(sign | 0x7c00u);
+    return (GLhalf)(sign | ((uint32_t)exponent << 10) | (mantissa >> 13));
+}
 
-// 頂点クラス
-// Vertex class
+// 頂点クラス (8バイト). 位置は±1の整数なので符号付き8bit, 面内の座標は半精度で持つ
+// Vertex class (8 bytes): positions are the integers ±1 so they fit in signed bytes; texcoords are half floats
 struct Vertex {
-    Vertex(const glm::vec3 &position_, const glm::vec3 &color_, const glm::vec2 &texcoord_ = glm::vec2(0.0f))
-        : position(position_)
-        , color(color_)
-        , texcoord(texcoord_) {
+    Vertex(const glm::vec3 &position_, int face_, const glm::vec2 &texcoord_ = glm::vec2(0.0f))
+        : position{ (GLbyte)position_.x, (GLbyte)position_.y, (GLbyte)position_.z }
+        , face((GLubyte)face_)
+        , texcoord{ toHalf(texcoord_.x), toHalf(texcoord_.y) } {
     }
 
-    glm::vec3 position;
-    glm::vec3 color;
-    glm::vec2 texcoord; // 追加
+    GLbyte position[3];
+    GLubyte face;       // 面番号 = 色パレット (u_faceColors) の番号 (0:+X, 1:+Y, 2:+Z, 3:-Z, 4:-Y, 5:-X)
+    GLhalf texcoord[2]; // 面内の頂点座標 (0 or 1)
 };
+static_assert(sizeof(Vertex) == 8, "Vertex must stay tightly packed");
+
+// 小立方体1個分の頂点数 (6面×4隅). シェーダはgl_VertexIDをこれで割って小立方体の番号を得る
+// Vertices per cubie (6 faces x 4 corners); the shader divides gl_VertexID by this to get the cubie number
+static const int VERTICES_PER_CUBIE = 24;
 
 // clang-format off
 static const glm::vec3 positions[8] = {
@@ -86,6 +137,17 @@ static const glm::vec3 colors[8] = {
     glm::vec3(1.0f, 1.0f, 1.0f)   // 白
 };
 
+// 各面のステッカーの色 (外側の面のみ. 内側の面は黒)
+// Sticker colour of each face (outer faces only; inner faces are black)
+static const glm::vec3 faceColors[6] = {
+    colors[0],  // +X = 赤
+    colors[1],  // +Y = 緑
+    colors[2],  // +Z = 青
+    colors[5],  // -Z = マゼンタ
+    colors[7],  // -Y = 白
+    colors[3]   // -X = 黄
+};
+
 static const unsigned int faces[12][3] = {
     { 7, 4, 1 }, { 7, 1, 6 },
     { 2, 4, 7 }, { 2, 7, 5 },
@@ -96,73 +158,183 @@ static const unsigned int faces[12][3] = {
 };
 
 
-GLuint textureId;
-GLuint settingTexId;
+// 画像から作るテクスチャは一度だけ読み込み, 両方のモードで共有する.
+// 下の3つは描画用にresourcesが所有しているものを指すだけ
+// Textures built from images are loaded once and shared by both modes;
+// the ids below only refer to objects owned by resources.
+ResourceManager resources;
+GLuint textureId = 0;
+GLuint settingTexId = 0;
+
+// 設定画面やHUDの2D描画 (VAOとバッファは初期化時に一度だけ作る)
+// 2D overlay for the setting screen and HUD (VAO and buffer are created once at init)
+SpriteBatch spriteBatch;
 
 // グローバル変数
 int settingImgWidth = 1, settingImgHeight = 1;
 
-void loadSettingTexture() {
-    int width, height, channels;
-    unsigned char *data = stbi_load(SETTING_IMAGE.c_str(), &width, &height, &channels, STBI_rgb_alpha);
-    if (!data) {
-        std::cerr << "Failed to load texture: data/setting.png" << std::endl;
-        exit(1);
-    }
-    settingImgWidth = width;
-    settingImgHeight = height;
-    glGenTextures(1, &settingTexId);
-    glBindTexture(GL_TEXTURE_2D, settingTexId);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
+void markDirty();
+
+// シェーダと画像はパック (make packで作る) から読む. パックより新しい個別のファイルがあればそちらを使う
+// Shaders and images come from the asset pack (built by make pack); loose files newer than the pack win
+AssetPack assets(SOURCE_DIRECTORY);
+
+// 画像のデコードはスレッドプールで並列に行い, 終わったものから転送する
+// Images are decoded in parallel on a thread pool and uploaded as they finish
+ImageLoader imageLoader;
+
+// ミップマップ込みで (できればBC1に圧縮して) 保存したテクスチャ. 2回目以降はデコードしない
+// Textures stored with their mip chains (BC1-compressed where possible); later runs skip decoding
+TextureCache textureCache(std::string(CACHE_DIRECTORY) + "textures/");
+
+// 転送が終わった画像. 終わるまで面はfaceColorsの色で描き, アイコンは貼らず, 設定画面は灰色にする
+// Images uploaded so far; until then faces use faceColors, the icon is left out and the setting screen is grey
+int readyFaces = 0;          // ビットiが立っていれば面iの画像がある / Bit i set: face i's image is uploaded
+bool iconReady = false;
+bool settingReady = false;
+
+GLTexture loadSettingTexture() {
+    GLTexture texture = GLTexture::create();
+    glBindTexture(GL_TEXTURE_2D, texture);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    stbi_image_free(data);
+
+    const GLuint textureId = texture;
+    auto fetch = []() {
+        const Asset source = assets.find(SETTING_IMAGE);
+        return textureCache.fetch(SETTING_IMAGE, source, "", false, [&source]() { return ImageLoader::decodeAsset(source); });
+    };
+    imageLoader.submitTask<CachedTexture>(fetch, [textureId](CachedTexture &cached) {
+        if (!cached.valid()) {
+            std::cerr << "Failed to load texture: " << SETTING_IMAGE << std::endl;
+            return;
+        }
+        settingImgWidth = cached.width;
+        settingImgHeight = cached.height;
+        glBindTexture(GL_TEXTURE_2D, textureId);
+        uploadTexture2D(cached);
+        settingReady = true;
+        markDirty();
+    });
+    return texture;
 }
 
 // --- テクスチャの読み込み ---
-void loadTexture() {
-    int width, height, channels;
-    unsigned char *data = stbi_load(TEX_FILE.c_str(), &width, &height, &channels, STBI_rgb_alpha);
-    if (!data) {
-        std::cerr << "Failed to load texture: " << TEX_FILE << std::endl;
-        exit(1);
-    }
-
-    glGenTextures(1, &textureId);
-    glBindTexture(GL_TEXTURE_2D, textureId);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
+GLTexture loadTexture() {
+    GLTexture texture = GLTexture::create();
+    glBindTexture(GL_TEXTURE_2D, texture);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    stbi_image_free(data);
+    const GLuint textureId = texture;
+    auto fetch = []() {
+        const Asset source = assets.find(TEX_FILE);
+        return textureCache.fetch(TEX_FILE, source, "", false, [&source]() { return ImageLoader::decodeAsset(source); });
+    };
+    imageLoader.submitTask<CachedTexture>(fetch, [textureId](CachedTexture &cached) {
+        if (!cached.valid()) {
+            std::cerr << "Failed to load texture: " << TEX_FILE << std::endl;
+            return;
+        }
+        glBindTexture(GL_TEXTURE_2D, textureId);
+        uploadTexture2D(cached);
+        iconReady = true;
+        markDirty();
+    });
+    return texture;
+}
+
+// 面の画像の上限の大きさ (画素). 一番近い面を正面から見た時に画面上で占める大きさを超えないようにする.
+// 小立方体は1辺1で, キューブ全体は原点を中心とする1辺3の立方体
+// Upper bound on the face image size in pixels: no larger than the biggest a face can
+// appear on screen, i.e. the nearest face seen head-on. Cubies are 1 unit wide and the
+// whole cube is a 3-unit cube centred on the origin.
+int maxFaceTextureSize() {
+    int framebufferWidth = WIN_WIDTH, framebufferHeight = WIN_HEIGHT;
+    if (GLFWwindow *window = glfwGetCurrentContext()) {
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    }
+    // 視点からキューブの外接球までの距離 / Distance from the eye to the cube's bounding sphere
+    const float nearest = glm::length(CAMERA_EYE) - 1.5f * std::sqrt(3.0f);
+    const float stickerPixels = framebufferHeight * 0.5f / (nearest * std::tan(CAMERA_FOVY * 0.5f));
+
+    // 3x3枚のステッカーで1面. 2の冪に切り上げ, 窓を少し広げても足りるようにする
+    // A face spans 3x3 stickers; rounding up to a power of two leaves room for a somewhat larger window
+    int size = 256;
+    while (size < 3 * stickerPixels) size *= 2;
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    return maxTextureSize > 0 ? std::min(size, (int)maxTextureSize) : size;
 }
 
 // ARTモードでのテクスチャ読み込み
-void loadTextures() {
+// 6面の画像を1つの配列テクスチャにまとめる. 大きさの違う画像は共通のレイヤーサイズにリサンプルする.
+// 画面に出せる大きさ (maxFaceTextureSize) より大きい画像はそこまで縮める.
+// デコードとリサンプルはワーカースレッドで並列に行い, 終わった面から転送する.
+// 面の画像は不透明として扱い, キャッシュからBC1のミップマップをそのまま転送する
+// Load the six face images into one array texture, resampling them to a common layer size.
+// Images larger than the screen can show (maxFaceTextureSize) are shrunk down to it.
+// Decoding and resampling run in parallel on worker threads; each face is uploaded as it finishes.
+// Faces are treated as opaque, so their BC1 mip chains come straight from the texture cache
+GLTexture loadTextures() {
+    // 大きさはヘッダだけ読んで先に決める (デコードしないので速い)
+    // The layer size comes from the image headers alone (no decoding, so it is quick)
+    // 読めない面はここで1度だけ報告し, デコードも積まない (面の色で描かれ続ける)
+    // Unreadable faces are reported once here and never queued for decoding (they keep their face colour)
+    int layerWidth = 1, layerHeight = 1;
+    bool found[6] = {};
     for (int i = 0; i < 6; ++i) {
-        int width, height, channels;
-        unsigned char *data = stbi_load(TEX_FILES[i].c_str(), &width, &height, &channels, STBI_rgb_alpha);
-        if (!data) {
+        int width, height;
+        if (!ImageLoader::imageInfo(assets.find(TEX_FILES[i]), width, height)) {
             std::cerr << "Failed to load texture: " << TEX_FILES[i] << std::endl;
-            exit(1);
+            continue;
         }
-        glGenTextures(1, &textureIds[i]);
-        glBindTexture(GL_TEXTURE_2D, textureIds[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        stbi_image_free(data);
+        found[i] = true;
+        layerWidth = std::max(layerWidth, width);
+        layerHeight = std::max(layerHeight, height);
     }
+    const int maxSize = maxFaceTextureSize();
+    layerWidth = std::min(layerWidth, maxSize);
+    layerHeight = std::min(layerHeight, maxSize);
+
+    GLTexture texture = GLTexture::create();
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    const GLenum format = textureCache.opaqueFormat();
+    allocateTextureArray(format, layerWidth, layerHeight, 6);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    const GLuint textureId = texture;
+    const std::string variant = std::to_string(layerWidth) + "x" + std::to_string(layerHeight);
+    for (int i = 0; i < 6; ++i) {
+        if (!found[i]) continue;
+        auto fetch = [i, variant, layerWidth, layerHeight]() {
+            const Asset source = assets.find(TEX_FILES[i]);
+            return textureCache.fetch(TEX_FILES[i], source, variant, true, [&]() {
+                LoadedImage image = ImageLoader::decodeAsset(source);
+                resizeImage(image, layerWidth, layerHeight);
+                return image;
+            });
+        };
+        auto upload = [i, textureId, format, layerWidth, layerHeight](CachedTexture &cached) {
+            if (!cached.valid() || cached.format != format || cached.width != layerWidth || cached.height != layerHeight) {
+                std::cerr << "Failed to load texture: " << TEX_FILES[i] << std::endl;
+                return;
+            }
+            glBindTexture(GL_TEXTURE_2D_ARRAY, textureId);
+            uploadTextureLayer(cached, i);
+            readyFaces |= 1 << i;
+            markDirty();
+        };
+        imageLoader.submitTask<CachedTexture>(fetch, upload);
+    }
+    return texture;
 }
 
 const int CYLINDER_SEGMENTS = 32;  // 円周の分割数
@@ -192,27 +364,66 @@ std::vector<float> genCylinderMesh_Xaxis() {
 
 
 
+// 小立方体の配置. 向きは行列ではなく回転群の元の番号で持つので, 何手回しても誤差が溜まらない
+// Cubie placement. The orientation is a rotation-group index rather than a matrix,
+// so it stays exact however many moves are made
 struct Cube {
-    glm::mat4 transform;
     glm::ivec3 logicalPos;           // 論理位置 (x,y,z)
-    glm::vec3 faceColors[6];         // 各面の色
+    uint8_t rotation = 0;            // 向き (cubeRotation()の番号) / Orientation (index for cubeRotation())
 };
 
 Cube cubes[3][3][3];
+static const int NUM_CUBIES = 27;
+
+// 小立方体の配置が変わり, 配置のuniformと見える面を作り直す必要があるか
+// Whether cubie placements changed, so the placement uniforms and the visible faces need rebuilding
+bool cubiesDirty = true;
 
 
 // clang-format on
 
 // バッファを参照する番号
 // Indices for vertex/index buffers
-GLuint vaoId;
-GLuint vertexBufferId;
-GLuint indexBufferId;
-GLuint textureBufferId;
-
-// シェーダプログラムを参照する番号
-// Index for a shader program
-GLuint programId;
+GLVertexArray vaoId;
+GLBuffer vertexBufferId;
+GLBuffer indexBufferId;
+
+// インデックスバッファに入っている見える面の数と, それを作った時に回していた層 (軸*3+層番号, 無ければ-1)
+// Number of visible faces in the index buffer, and the turning layer it was built for (axis*3+index, -1 if none)
+int visibleFaceCount = 0;
+int visibleFacesTurn = -1;
+
+// シェーダプログラム (uniform変数の位置はリンク時に取得済み)
+// Shader program (uniform locations are reflected at link time)
+ShaderProgram program;
+
+// 描画で使うuniform変数のハンドル
+// Handles of the uniforms used for drawing
+struct RenderUniforms {
+    ShaderProgram::Uniform mvpMat;
+    ShaderProgram::Uniform object;
+    ShaderProgram::Uniform mode;
+    ShaderProgram::Uniform color;
+    ShaderProgram::Uniform faceColors;
+    ShaderProgram::Uniform sampler;
+    ShaderProgram::Uniform faceSampler;
+    ShaderProgram::Uniform rotations;
+    ShaderProgram::Uniform cubies;
+    ShaderProgram::Uniform readyFaces;
+    ShaderProgram::Uniform iconReady;
+} uniforms;
+
+// フレームごとの行列 (uniformブロック "FrameMatrices", std140)
+// Per-frame matrices (uniform block "FrameMatrices", std140 layout)
+struct FrameMatrices {
+    glm::mat4 projMat;
+    glm::mat4 viewMat;
+    glm::mat4 worldMat;  // アークボール操作による全体の変換 / Whole-puzzle arcball transform
+    glm::ivec4 turnLayer;  // 回している層 (x=軸, y=層番号). 回していなければx=-1 / Turning layer (x = axis, y = index), x = -1 when idle
+    glm::vec4 turnAngle;   // x=回転角 (ラジアン) / x = angle in radians
+};
+static const GLuint FRAME_BLOCK_BINDING = 0;
+UniformBuffer frameBuffer;
 
 // マウスドラッグ中かどうか
 // Flag to check mouse is dragged or not
@@ -239,14 +450,6 @@ glm::mat4 viewMat, projMat;
 glm::mat4 acRotMat, acTransMat, acScaleMat;
 float acScale = 1.0f;
 
-// 立方体の回転角度
-// Rotation angle for animating a cube
-static float theta = 0.0f;
-
-// オブジェクトを選択するためのID
-// Index for identifying selected object
-bool selectMode = false;
-
 struct ArcballObject {
     glm::mat4 rotMat = glm::mat4(1.0f);
     glm::mat4 transMat = glm::mat4(1.0f);
@@ -258,166 +461,187 @@ struct ArcballObject {
 int selectedCube = 0;   // どちらが選択中か（0 or 1）
 glm::mat4 globalRotMat = glm::mat4(1.0f);  // ルービックキューブ全体の回転行列
 
+// 描き直しが必要か. 見た目に関わる状態 (キューブ, アークボール, 画面) を変えたら立てる.
+// 何も変わらずアニメーションもない間は描画せず, イベントが来るまで眠る
+// Whether the window needs redrawing; set whenever cube, arcball or UI state changes.
+// While nothing changes and nothing animates, the main loop skips drawing and sleeps.
+bool sceneDirty = true;
+void markDirty() { sceneDirty = true; }
+
+// 止まっている間にイベントを待つ最長時間と, 裏の処理 (探索, 読み戻し) を待つ間の確認間隔 (秒)
+// Longest sleep while idle, and the polling interval while background work (search, readback) runs (seconds)
+static const double IDLE_WAIT_TIMEOUT = 0.5;
+static const double BACKGROUND_POLL_INTERVAL = 1.0 / 60.0;
+
+// 論理モデル (描画はここから読み出した配置だけを使う)
+// Logical model; rendering only reads placements derived from it
+CubeState cubeState;
+
+// 24通りの向きの回転行列 (最初に使う時に一度だけ作る)
+// Rotation matrices of the 24 orientations (built once, on first use)
+const glm::mat3 *rotationMatrices() {
+    static const struct Table {
+        glm::mat3 m[24];
+        Table() {
+            for (int i = 0; i < 24; ++i) {
+                // cubeRotationは行優先, glmは列優先
+                const int (&R)[3][3] = cubeRotation(i);
+                for (int col = 0; col < 3; ++col)
+                    for (int row = 0; row < 3; ++row)
+                        m[i][col][row] = (float)R[row][col];
+            }
+        }
+    } table;
+    return table.m;
+}
+
+// 止まっている時の小立方体の変換 (向きは表から引くだけ)
+// Resting transform of a cubie (the orientation is just a table lookup)
+glm::mat4 cubeRestTransform(const Cube &cube) {
+    const glm::vec3 offset = glm::vec3(cube.logicalPos - glm::ivec3(1)) * 1.1f;
+    return glm::translate(glm::mat4(1.0f), offset) * glm::mat4(rotationMatrices()[cube.rotation]);
+}
+
+// 論理モデルから各小立方体の位置と向きを読み出す (整数だけなので誤差が溜まらない)
+// Read every cubie's position and orientation from the logical model (integers only, so no drift)
+void syncCubesFromState() {
+    CubiePlacement placements[NUM_CUBIES];
+    cubeState.placements(placements);
+    for (const CubiePlacement& p : placements) {
+        Cube& cube = cubes[p.home[0]][p.home[1]][p.home[2]];
+        cube.logicalPos = glm::ivec3(p.position[0], p.position[1], p.position[2]);
+        cube.rotation = p.rotation;
+    }
+    cubiesDirty = true;
+    markDirty();
+}
+
+// キューブ全体に掛かる変換 (アークボールと全体の回転)
+// Transform applied to the whole cube (arcball and global rotation)
+glm::mat4 cubeWorldMatrix() {
+    return acTransMat * globalRotMat * acRotMat * acScaleMat;
+}
 
 // 3x3x3のルービックキューブ構造（各小立方体の変換行列）
 // 3x3x3 Rubik's cube: transformation matrix for each small cube
 void initCubes() {
-    for (int x = 0; x < 3; ++x) {
-        for (int y = 0; y < 3; ++y) {
-            for (int z = 0; z < 3; ++z) {
-                Cube& cube = cubes[x][y][z];
-                cube.logicalPos = glm::ivec3(x, y, z);
-
-                glm::vec3 offset = glm::vec3(x - 1, y - 1, z - 1) * 1.1f;
-                cube.transform = glm::translate(glm::mat4(1.0f), offset);
-
-                for (int f = 0; f < 6; ++f)
-                    cube.faceColors[f] = colors[6];  // 黒で初期化
-
-                // 外側の面だけ色を付ける
-                if (x == 2) cube.faceColors[0] = colors[0]; // +X = 赤
-                if (x == 0) cube.faceColors[5] = colors[3]; // -X = 黄
-                if (y == 2) cube.faceColors[1] = colors[1]; // +Y = 緑
-                if (y == 0) cube.faceColors[4] = colors[7]; // -Y = シアン
-                if (z == 2) cube.faceColors[2] = colors[2]; // +Z = 青
-                if (z == 0) cube.faceColors[3] = colors[5]; // -Z = マゼンタ
-            }
-        }
-    }
+    cubeState = CubeState::solved();
+    syncCubesFromState();
 }
 
 
 void initRubikVAO() {
+    // 27個の小立方体の全ての面. 小立方体の配置はuniformで渡すので頂点は変わらず,
+    // 描く面はインデックスバッファで選ぶ (updateVisibleFaces)
+    // 面の4隅は2つの三角形で共有する (小立方体cの面fの隅kは (c*6+f)*4+k 番)
+    // Every face of all 27 cubies. Placements are passed as uniforms, so the vertices never change;
+    // the index buffer selects which faces are drawn (updateVisibleFaces).
+    // The four corners of a face are shared by its two triangles (corner k of face f of cubie c is vertex (c*6+f)*4+k)
     std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
-    int idx = 0;
+    vertices.reserve(NUM_CUBIES * VERTICES_PER_CUBIE);
 
-    if (ArtMode) {
-        for (int x = 0; x < 3; ++x) {
-            for (int y = 0; y < 3; ++y) {
-                for (int z = 0; z < 3; ++z) {
-                    for (int f = 0; f < 6; ++f) {
-                        // 外側の面かどうか
-                        bool isOuter =
-                            (f == 0 && x == 2) || // +X
-                            (f == 1 && y == 2) || // -X
-                            (f == 2 && z == 2) || // +Y
-                            (f == 3 && z == 0) || // -Y
-                            (f == 4 && y == 0) || // +Z
-                            (f == 5 && x == 0);   // -Z
-
-                        // テクスチャ座標の計算（ArtMode用）
-                        int i = 0, j = 0;
-                        if (isOuter) {
-                            switch (f) {
-                                case 0: i = 2-z;     j = 2-y; break; // +X
-                                case 1: i = x;     j = z;     break; // -X
-                                case 2: i = x;     j = 2-y; break; // +Y
-                                case 3: i = 2-x;     j = 2-y;     break; // -Y
-                                case 4: i = x;     j = 2-z; break; // +Z
-                                case 5: i = z;     j = 2-y;     break; // -Z
-                            }
-                        }
-                        float u0 = isOuter ? i / 3.0f : 0.0f;
-                        float v0 = isOuter ? j / 3.0f : 0.0f;
-                        float u1 = isOuter ? (i + 1) / 3.0f : 0.0f;
-                        float v1 = isOuter ? (j + 1) / 3.0f : 0.0f;
-
-                        glm::vec2 texcoords[3] = {
-                            glm::vec2(u0, v0), glm::vec2(u1, v0), glm::vec2(u1, v1)
-                        };
-                        glm::vec2 texcoords2[3] = {
-                            glm::vec2(u0, v0), glm::vec2(u1, v1), glm::vec2(u0, v1)
-                        };
-
-                        // 2三角形×3頂点ずつ
-                        for (int tri = 0; tri < 2; ++tri) {
-                            for (int jv = 0; jv < 3; ++jv) {
-                                int vidx = faces[f * 2 + tri][jv];
-                                glm::vec2 tc = glm::vec2(0.0f);
-                                if (isOuter) {
-                                    if (tri == 0)      tc = texcoords[jv];
-                                    else if (tri == 1) tc = texcoords2[jv];
-                                }
-                                Vertex v(positions[vidx], cubes[x][y][z].faceColors[f], tc);
-                                vertices.push_back(v);
-                                indices.push_back(idx++);
-                            }
-                        }
-                    }
-                }
-            }
-        }
-    } else {
-        // 3x3x3個の小立方体ごとにデータ生成
-        for (int x = 0; x < 3; ++x) {
-            for (int y = 0; y < 3; ++y) {
-                for (int z = 0; z < 3; ++z) {
-                    // 各面ごとに
-                    for (int f = 0; f < 6; ++f) {
-                        // テクスチャ座標
-                        glm::vec2 texcoords[3] = {
-                            glm::vec2(0, 0), glm::vec2(1, 0), glm::vec2(1, 1)
-                        };
-                        glm::vec2 texcoords2[3] = {
-                            glm::vec2(0, 0), glm::vec2(1, 1), glm::vec2(0, 1)
-                        };
-
-                        bool isIconFace = (x == 1 && y == 0 && z == 1 && f == 4); // 白面中心か
-                        
-                        // 2三角形×3頂点ずつ
-                        for (int j = 0; j < 3; ++j) {
-                            glm::vec2 tc = glm::vec2(0.0f);
-                            if (isIconFace) tc = texcoords[j];
-                            Vertex v(positions[faces[f * 2 + 0][j]], cubes[x][y][z].faceColors[f], tc);
-                            vertices.push_back(v);
-                            indices.push_back(idx++);
-                        }
-                        for (int j = 0; j < 3; ++j) {
-                            glm::vec2 tc = glm::vec2(0.0f);
-                            if (isIconFace) tc = texcoords2[j];
-                            Vertex v(positions[faces[f * 2 + 1][j]], cubes[x][y][z].faceColors[f], tc);
-                            if (isIconFace) tc = texcoords[j];
-                            vertices.push_back(v);
-                            indices.push_back(idx++);
-                        }
-                    }
-                }
+    // 面内の頂点座標 / Texcoords of the corners
+    const glm::vec2 texcoords[4] = {
+        glm::vec2(0, 0), glm::vec2(1, 0), glm::vec2(1, 1), glm::vec2(0, 1)
+    };
+
+    for (int cubie = 0; cubie < NUM_CUBIES; ++cubie) {
+        for (int f = 0; f < 6; ++f) {
+            // facesの2つの三角形 (A,B,C), (A,C,D) から4隅を取り出す
+            // Take the four corners from the two triangles (A,B,C), (A,C,D) in faces
+            const unsigned int corners[4] = { faces[f * 2][0], faces[f * 2][1], faces[f * 2][2], faces[f * 2 + 1][2] };
+            for (int k = 0; k < 4; ++k) {
+                vertices.push_back(Vertex(positions[corners[k]], f, texcoords[k]));
             }
         }
     }
 
     // VAO/VBO/EBOの処理
-    glGenVertexArrays(1, &vaoId);
+    vaoId = GLVertexArray::create();
     glBindVertexArray(vaoId);
 
-    glGenBuffers(1, &vertexBufferId);
+    vertexBufferId = GLBuffer::create();
     glBindBuffer(GL_ARRAY_BUFFER, vertexBufferId);
     glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
 
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, position));
+    glVertexAttribPointer(0, 3, GL_BYTE, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, position));
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, color));
+    glVertexAttribIPointer(1, 1, GL_UNSIGNED_BYTE, sizeof(Vertex), (void *)offsetof(Vertex, face));
 
     glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, texcoord));
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, texcoord));
 
-    glGenBuffers(1, &indexBufferId);
+    // インデックスバッファ (中身は見える面が変わった時にupdateVisibleFacesで書き込む)
+    // Index buffer (filled by updateVisibleFaces whenever the visible faces change)
+    indexBufferId = GLBuffer::create();
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferId);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * NUM_CUBIES * 36, NULL, GL_DYNAMIC_DRAW);
+    visibleFaceCount = 0;
+    cubiesDirty = true;
 
     glBindVertexArray(0);
 }
+
+// 見える面だけを描くインデックスを作る. 止まっている時はキューブの表面の54面だけ,
+// 層を回している間はその層と隣の層が向かい合う内側の面も加える. VAOをバインドしてから呼ぶ
+// Build the indices of the faces that can be seen: the 54 outer faces at rest, plus the inner
+// faces where the turning layer meets its neighbours while a turn is in progress. Call with the VAO bound.
+void updateVisibleFaces(int turnAxis, int turnIndex) {
+    static const int FACE_NORMALS[6][3] = {
+        { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }, { 0, -1, 0 }, { -1, 0, 0 }
+    };
+
+    // 隅の番号で2つの三角形. facesの順は外から見て時計回りなので逆順にする (裏面カリング用)
+    // Corner order of the two triangles; faces is clockwise seen from outside, so it is reversed for back-face culling
+    static const GLushort FACE_TRIANGLES[6] = { 0, 2, 1, 0, 3, 2 };
+
+    std::vector<GLushort> indices;
+    indices.reserve(NUM_CUBIES * 36);
+    for (int x = 0; x < 3; ++x) {
+        for (int y = 0; y < 3; ++y) {
+            for (int z = 0; z < 3; ++z) {
+                const Cube &cube = cubes[x][y][z];
+                const int (&R)[3][3] = cubeRotation(cube.rotation);
+                const int cubie = x * 9 + y * 3 + z;
+                for (int f = 0; f < 6; ++f) {
+                    // 今の向きでの面の法線と, その先の位置 / Face normal in the current orientation and the cell beyond it
+                    int n[3], beyond[3];
+                    bool outside = false;
+                    for (int a = 0; a < 3; ++a) {
+                        n[a] = R[a][0] * FACE_NORMALS[f][0] + R[a][1] * FACE_NORMALS[f][1] + R[a][2] * FACE_NORMALS[f][2];
+                        beyond[a] = cube.logicalPos[a] + n[a];
+                        outside = outside || beyond[a] < 0 || beyond[a] > 2;
+                    }
+
+                    bool visible = outside;
+                    if (!visible && turnAxis >= 0 && n[turnAxis] != 0) {
+                        visible = cube.logicalPos[turnAxis] == turnIndex || beyond[turnAxis] == turnIndex;
+                    }
+                    if (!visible) continue;
+
+                    const GLushort first = (GLushort)((cubie * 6 + f) * 4);
+                    for (GLushort corner : FACE_TRIANGLES) indices.push_back((GLushort)(first + corner));
+                }
+            }
+        }
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferId);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(GLushort) * indices.size(), indices.data());
+    visibleFaceCount = (int)indices.size() / 6;
+}
+
 // 軸の円柱VAO
 
-GLuint axisCylinderVao, axisCylinderVbo;
+GLVertexArray axisCylinderVao;
+GLBuffer axisCylinderVbo;
 
 void initAxisCylinderVAO() {
     std::vector<float> vertices = genCylinderMesh_Xaxis();
 
-    glGenVertexArrays(1, &axisCylinderVao);
-    glGenBuffers(1, &axisCylinderVbo);
+    axisCylinderVao = GLVertexArray::create();
+    axisCylinderVbo = GLBuffer::create();
 
     glBindVertexArray(axisCylinderVao);
     glBindBuffer(GL_ARRAY_BUFFER, axisCylinderVbo);
@@ -438,45 +662,21 @@ GLuint compileShader(const std::string &filename, GLuint type) {
     // Create a shader
     GLuint shaderId = glCreateShader(type);
 
-    // ファイルの読み込み
-    // Load source file
-    std::ifstream reader;
-    std::string code;
-
-    // ファイルを開く
-    // Open source file
-    reader.open(filename.c_str(), std::ios::in);
-    if (!reader.is_open()) {
+    // ソースの読み込み (パックかファイルをマップしたメモリをそのまま渡す)
+    // Load the source (the mapped pack or file is handed over without copying)
+    const Asset source = assets.find(filename);
+    if (!source.valid()) {
         // ファイルを開けなかったらエラーを出して終了
         // Finish with error message if source file could not be opened
         fprintf(stderr, "Failed to load a shader: %s\n", filename.c_str());
         exit(1);
     }
 
-    // ファイルをすべて読んで変数に格納
-    // Load entire contents of a file and store to a string variable
-    {
-        // ファイル読み取り位置を終端に移動 / Move seek position to the end
-        reader.seekg(0, std::ios::end);
-        // コードを格納する変数の大きさを予約 / Reserve memory location for code characters
-        code.reserve(reader.tellg());
-        // ファイルの読み取り位置を先頭に移動 / Move seek position back to the beginning
-        reader.seekg(0, std::ios::beg);
-
-        // 先頭からファイルサイズ分を読んでコードの変数に格納
-        // Load entire file and copy to "code" variable
-        code.assign(std::istreambuf_iterator<char>(reader),
-                    std::istreambuf_iterator<char>());
-    }
-
-    // ファイルを閉じる
-    // Close file
-    reader.close();
-
     // コードのコンパイル
     // Compile a source code
-    const char *codeChars = code.c_str();
-    glShaderSource(shaderId, 1, &codeChars, NULL);
+    const char *codeChars = (const char *)source.data;
+    const GLint codeLength = (GLint)source.size;
+    glShaderSource(shaderId, 1, &codeChars, &codeLength);
     glCompileShader(shaderId);
 
     // コンパイルの成否を判定する
@@ -503,7 +703,7 @@ GLuint compileShader(const std::string &filename, GLuint type) {
             // エラーメッセージとソースコードの出力
             // Print error message and corresponding source code
             fprintf(stderr, "[ ERROR ] %s\n", errMsg.c_str());
-            fprintf(stderr, "%s\n", code.c_str());
+            fprintf(stderr, "%.*s\n", (int)codeLength, codeChars);
         }
         exit(1);
     }
@@ -524,6 +724,9 @@ GLuint buildShaderProgram(const std::string &vShaderFile, const std::string &fSh
     GLuint programId = glCreateProgram();
     glAttachShader(programId, vertShaderId);
     glAttachShader(programId, fragShaderId);
+    // リンク結果をバイナリとして取り出せるようにする (ProgramCache用)
+    // Allow the linked binary to be read back (for ProgramCache)
+    glProgramParameteri(programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(programId);
 
     // リンクの成否を判定する
@@ -554,6 +757,13 @@ GLuint buildShaderProgram(const std::string &vShaderFile, const std::string &fSh
         exit(1);
     }
 
+    // リンク後はシェーダオブジェクトは不要なので削除する
+    // Shader objects are no longer needed once linked
+    glDetachShader(programId, vertShaderId);
+    glDetachShader(programId, fragShaderId);
+    glDeleteShader(vertShaderId);
+    glDeleteShader(fragShaderId);
+
     // シェーダを無効化した後にIDを返す
     // Disable shader program and return its ID
     glUseProgram(0);
@@ -563,32 +773,87 @@ GLuint buildShaderProgram(const std::string &vShaderFile, const std::string &fSh
 // シェーダの初期化
 // Initialization related to shader programs
 void initShaders() {
-    programId = buildShaderProgram(VERT_SHADER_FILE, FRAG_SHADER_FILE);
+    // ソースとドライバが前回と同じなら, 保存しておいたバイナリを使ってコンパイルを省く
+    // Reuse the stored binary (skipping compilation) when the sources and driver are unchanged
+    uint64_t sourceHash = FNV_OFFSET_BASIS;
+    for (const std::string &file : { VERT_SHADER_FILE, FRAG_SHADER_FILE }) {
+        const Asset source = assets.find(file);
+        sourceHash = fnv1a(source.data, source.size, sourceHash);
+    }
+    program = ShaderProgram(programCache.load("render", sourceHash, []() {
+        return buildShaderProgram(VERT_SHADER_FILE, FRAG_SHADER_FILE);
+    }));
+
+    uniforms.mvpMat = program.uniform("u_mvpMat");
+    uniforms.object = program.uniform("object");
+    uniforms.mode = program.uniform("u_mode");
+    uniforms.color = program.uniform("u_color");
+    uniforms.faceColors = program.uniform("u_faceColors");
+    uniforms.sampler = program.uniform("u_sampler");
+    uniforms.faceSampler = program.uniform("u_faceSampler");
+    uniforms.rotations = program.uniform("u_rotations");
+    uniforms.cubies = program.uniform("u_cubies");
+    uniforms.readyFaces = program.uniform("u_readyFaces");
+    uniforms.iconReady = program.uniform("u_iconReady");
+
+    // サンプラーのテクスチャユニットを固定 (型の違うサンプラーは同じユニットを共有できない)
+    // Fix sampler units up front (samplers of different types must not share a unit)
+    program.use();
+    program.set(uniforms.sampler, 0);
+    program.set(uniforms.faceSampler, 1);
+    program.set(uniforms.faceColors, faceColors, 6);
+    program.set(uniforms.rotations, rotationMatrices(), 24);
+    glUseProgram(0);
+
+    // フレームごとの行列はuniformブロックでまとめて渡す
+    // Per-frame matrices are passed through a uniform block
+    frameBuffer.init(sizeof(FrameMatrices), FRAME_BLOCK_BINDING);
+    if (!program.bindUniformBlock("FrameMatrices", FRAME_BLOCK_BINDING)) {
+        fprintf(stderr, "Uniform block \"FrameMatrices\" is not active in the shader program\n");
+    }
 }
 
-// ユーザ定義のOpenGLの初期化
-// User-define OpenGL initialization
+// キューブとアークボールを初期状態に戻す (GLのオブジェクトには触らない)
+// Put the cube and the arcball back to their initial state (no GL objects are touched)
+void resetScene() {
+    initCubes();
+
+    // アークボール操作のための変換行列を初期化
+    // Initialize transformation matrices for arcball control
+    acRotMat = glm::mat4(1.0);
+    acTransMat = glm::mat4(1.0);
+    acScaleMat = glm::mat4(1.0);
+}
+
+// ユーザ定義のOpenGLの初期化 (起動時に一度だけ呼ぶ)
+// User-define OpenGL initialization (called once at startup)
 void initializeGL() {
     // 深度テストの有効化
     // Enable depth testing
     glEnable(GL_DEPTH_TEST);
 
+    // 裏面カリングの有効化 (小立方体の面は外から見て反時計回り)
+    // Enable back-face culling (cubie faces are counter-clockwise seen from outside)
+    glEnable(GL_CULL_FACE);
+    glCullFace(GL_BACK);
+    glFrontFace(GL_CCW);
+
     // 背景色の設定 (黒)
     // Background color (black)
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
-    initCubes();
+    resetScene();
 
-    loadSettingTexture();
-    if (ArtMode) {
-        // ARTモードではテクスチャを読み込む
-        // Load textures in ART mode
-        loadTextures();
-    } else {
-        // 通常モードでは単一のテクスチャを読み込む
-        // Load a single texture in normal mode
-        loadTexture();
-    }
+    // 圧縮テクスチャが使えるか (読み込みを始める前に調べる)
+    // Check for compressed texture support before any loading starts
+    textureCache.detectCompression();
+
+    // 設定画面と通常モードのテクスチャは最初に読み込む. ARTモードの面の画像は
+    // ARTモードが選ばれた時に初めて読む (selectMode)
+    // The setting-screen and normal-mode textures are loaded up front; the ART mode face
+    // images are only loaded once ART mode is first chosen (see selectMode)
+    settingTexId = resources.texture(SETTING_IMAGE, loadSettingTexture);
+    textureId = resources.texture(TEX_FILE, loadTexture);          // 通常モード / Normal mode
 
     //initCubeTransforms();  // 3x3x3の小立方体の変換行列を初期化
     // VAOの初期化
@@ -598,24 +863,20 @@ void initializeGL() {
     // 軸の円柱VAOの初期化
     initAxisCylinderVAO();
 
+    // 2D描画用のバッファ / Buffers for 2D drawing
+    spriteBatch.init();
+
     // シェーダの用意
     // Prepare shader program
     initShaders();
 
     // カメラの姿勢を決定する変換行列の初期化
     // Initialize transformation matrices for camera pose
-    projMat = glm::perspective(glm::radians(45.0f), (float)WIN_WIDTH / (float)WIN_HEIGHT, 0.1f, 1000.0f);
+    projMat = glm::perspective(CAMERA_FOVY, (float)WIN_WIDTH / (float)WIN_HEIGHT, 0.1f, 1000.0f);
 
-    viewMat = glm::lookAt(glm::vec3(3.0f, 4.0f, 5.0f),   // 視点の位置 / Eye position
+    viewMat = glm::lookAt(CAMERA_EYE,                    // 視点の位置 / Eye position
                           glm::vec3(0.0f, 0.0f, 0.0f),   // 見ている先 / Looking position
                           glm::vec3(0.0f, 1.0f, 0.0f));  // 視界の上方向 / Upward vector
-
-    // アークボール操作のための変換行列を初期化
-    // Initialize transformation matrices for arcball control
-    acRotMat = glm::mat4(1.0);
-    acTransMat = glm::mat4(1.0);
-    acScaleMat = glm::mat4(1.0);
-
 }
 
 
@@ -624,88 +885,116 @@ void initializeGL() {
 int selectedAxis = 0;
 int selectedIndex = 0;
 
-// 90度回転後の座標を取得する関数
-std::pair<int, int> getLogicalPos(int i, int j, bool clockwise) {
-    if (clockwise) 
-        return {2 - j, i};  // 90度回転後の座標（2D）
-    else
-        return {j, 2 - i};  // -90度回転後の座標（2D）
-}
-std::pair<int, int> getLogicalPosoIverse(int i, int j) {
-    return {2 -i, 2 - j};  // 90度回転後の座標（2D）
-}
-
-std::vector<glm::ivec3> targets;
-glm::mat4 originalTransforms[3][3][3];
-glm::vec3 center(0.0f);
 bool clockwise = true;
 
-void applyRotation(int axis, int index, float angleStep, float rotationAngle, bool rotating_in) {
-    bool is90Final = rotating_in;
-
-    glm::vec3 axisVec = (axis == 0) ? glm::vec3(1, 0, 0)
-                     : (axis == 1) ? glm::vec3(0, 1, 0)
-                                   : glm::vec3(0, 0, 1);
-    
-    if (rotating_in) {
-        // アニメーション開始時に保存
-        if (rotationAngle == angleStep) {
-            for (int x = 0; x < 3; ++x)
-            for (int y = 0; y < 3; ++y)
-                for (int z = 0; z < 3; ++z) {
-                    const Cube& cube = cubes[x][y][z];
-                    glm::ivec3 p = cube.logicalPos;
-                    if ((axis == 0 && p.x == index) ||
-                        (axis == 1 && p.y == index) ||
-                        (axis == 2 && p.z == index)) {
-                        targets.emplace_back(x, y, z);
-                        center += glm::vec3(p - glm::ivec3(1)) * 1.1f;
-                    }
-                }
+bool rotating = false;
+float rotationAngle = 0.0f;
+double rotationStartTime = 0.0;  // 回転を始めた時刻 (glfwGetTime) / Start time of the turn
+float currentTurnDuration = 0.0f;
+// 回転の始めと終わりの角度, 終わった時に論理モデルに適用する1/4回転の数 (clockwiseの向き)
+// Start and end angles of the turn, and how many quarter turns (in the clockwise direction) to apply at the end
+float turnFromAngle = 0.0f;
+float turnToAngle = 90.0f;
+int turnQuarters = 1;
+// マウスで層をつかんでいる間は, 角度をカーソルが決める
+// While a layer is dragged with the mouse, the cursor drives its angle
+bool layerDragging = false;
+
+// これから回す手 (キー入力, シャッフル, 解法). update()が1手ずつ取り出す
+// Pending moves from key input, shuffles and solutions; update() takes them one at a time
+MoveQueue moveQueue;
+// ソルバーは別スレッドで動かし, 描画を止めない
+// The solver runs on a worker thread so that rendering never stalls
+AsyncSolver solver;
+bool isShuffling = false;
+std::string shuffleName = "Shuffle";  // 終了時の表示用 / Shown when the sequence completes
+
+// 0〜1の進み具合を補間曲線で変換する / Map turn progress (0-1) through the easing curve
+float easeTurn(float t) {
+    switch (turnEasing) {
+    case EASE_IN_OUT:
+        return t < 0.5f ? 4.0f * t * t * t : 1.0f - 4.0f * (1.0f - t) * (1.0f - t) * (1.0f - t);
+    case EASE_OUT:
+        return 1.0f - (1.0f - t) * (1.0f - t) * (1.0f - t);
+    default:
+        return t;
+    }
+}
 
-            center /= (float)targets.size();
-            for (const auto& idx : targets)
-                originalTransforms[idx.x][idx.y][idx.z] = cubes[idx.x][idx.y][idx.z].transform;
-        }
+// 1手の回転を始める / Start a layer turn
+void startTurn(int axis, int index, bool clockwise_in) {
+    selectedAxis = axis;
+    selectedIndex = index;
+    clockwise = clockwise_in;
+    rotationAngle = 0.0f;
+    turnFromAngle = 0.0f;
+    turnToAngle = clockwise ? 90.0f : -90.0f;
+    turnQuarters = 1;
+    rotationStartTime = glfwGetTime();
+    rotating = true;
+
+    // 手が溜まっているほど速く回し, 残り全部がmaxInputLag秒以内に終わるようにする
+    // The deeper the queue, the faster the turn, so that everything pending ends within maxInputLag
+    currentTurnDuration = turnDuration;
+    if (catchUpMode && !isShuffling) {
+        currentTurnDuration = std::min(turnDuration, maxInputLag / (moveQueue.size() + 1));
+    }
+}
 
-        glm::mat4 M = glm::rotate(glm::radians(rotationAngle), axisVec);
+// 回している層の角度をangle (度) にする. 層の小立方体はシェーダがこの角度で回す
+// Set the angle (degrees) of the turning layer; the shader rotates its cubies
+void setLayerAngle(float angle) {
+    rotationAngle = angle;
+    markDirty();
+}
 
-        for (const auto& idx : targets)
-            cubes[idx.x][idx.y][idx.z].transform = M * originalTransforms[idx.x][idx.y][idx.z];
+// 小立方体の今の変換 (回している層なら途中の角度も含む). シェーダと同じ計算 (クリック判定用)
+// Current transform of a cubie, including the in-progress turn; mirrors the shader (used for picking)
+glm::mat4 cubieTransform(const glm::ivec3 &home) {
+    const Cube &cube = cubes[home.x][home.y][home.z];
+    if (!rotating || cube.logicalPos[selectedAxis] != selectedIndex) return cubeRestTransform(cube);
+    glm::vec3 axisVec(0.0f);
+    axisVec[selectedAxis] = 1.0f;
+    return glm::rotate(glm::radians(rotationAngle), axisVec) * cubeRestTransform(cube);
+}
 
+// 経過時間から回転角を求めて層を回す. 時間を過ぎたら論理モデルに手を適用し,
+// 描画用の変換を論理モデルから作り直すので, 最後は必ずちょうど90度の倍数になる
+// Advance the current turn from the elapsed time. Once the duration has passed the moves are
+// applied to the logical model and the transforms are rebuilt from it, so a turn always ends on an exact multiple of 90 degrees
+void advanceTurn() {
+    if (!rotating || layerDragging) return;
+
+    const double elapsed = glfwGetTime() - rotationStartTime;
+    if (currentTurnDuration <= 0.0f || elapsed >= currentTurnDuration) {
+        for (int i = 0; i < turnQuarters; ++i) cubeState.apply(makeMove(selectedAxis, selectedIndex, clockwise));
+        syncCubesFromState();
+        rotationAngle = turnToAngle;
+        rotating = false;
         return;
-    } else {
-        for (const auto& idx : targets) {
-            const Cube& cube_1 = cubes[idx.x][idx.y][idx.z];
-            glm::ivec3 p_1 = cube_1.logicalPos;
-            if (axis == 0) {
-                auto [ni, nj] = getLogicalPos(p_1.y, p_1.z, clockwise);  // 90度回転後の座標（2D）
-                glm::ivec3 newPos;
-                // printf("idx: %d, %d, %d, OldPos: %d, %d, %d-> %d, %d, %d, rotationAngle: %f\n", idx.x, idx.y, idx.z, p_1.x, p_1.y, p_1.z, index, ni, nj, rotationAngle);
-                newPos = glm::ivec3(index, ni, nj);
-                cubes[idx.x][idx.y][idx.z].logicalPos = newPos;
-            } else if (axis == 1) {
-                auto [ni, nj] = getLogicalPos(p_1.z, p_1.x, clockwise);  // 90度回転後の座標（2D）
-                // printf("idx: %d, %d, %d, OldPos: %d, %d, %d-> %d, %d, %d, rotationAngle: %f\n", idx.x, idx.y, idx.z, p_1.x, p_1.y, p_1.z, nj, index, ni,rotationAngle);
-                glm::ivec3 newPos;
-                newPos = glm::ivec3(nj, index, ni);
-                cubes[idx.x][idx.y][idx.z].logicalPos = newPos;
-            } else if (axis == 2) {
-                auto [ni, nj] = getLogicalPos(p_1.x, p_1.y, clockwise);  // 90度回転後の座標（2D）
-                glm::ivec3 newPos;
-                newPos = glm::ivec3(ni, nj, index);
-                cubes[idx.x][idx.y][idx.z].logicalPos = newPos;
-            }
-        targets.clear();
-        }
     }
 
+    const float t = easeTurn((float)(elapsed / currentTurnDuration));
+    setLayerAngle(turnFromAngle + (turnToAngle - turnFromAngle) * t);
 }
 
 
 // ユーザ定義のOpenGL描画
 // User-defined OpenGL drawing
 bool selectingMode = true; // ←追加: モード選択中かどうか
+
+// モードを決めて設定画面を閉じる. GLのオブジェクトは両モードで共有なので作り直さず,
+// キューブを初期状態に戻すだけ. ARTモードの面の画像は初めて選ばれた時に読み込む
+// Pick a mode and leave the setting screen. GL objects are shared by both modes, so only
+// the scene is reset; the ART mode face images are loaded the first time it is chosen.
+void selectMode(bool art) {
+    ArtMode = art;
+    if (ArtMode) faceArrayTexId = resources.texture("faces", loadTextures);
+    selectingMode = false;
+    resetScene();
+    markDirty();
+}
+
 bool AxisVisible = true; // 軸の表示切替
 
 void paintGL() {
@@ -713,34 +1002,21 @@ void paintGL() {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     // シェーダプログラムの有効化
-    glUseProgram(programId);
+    program.use();
 
     // VAOのバインド
     glBindVertexArray(vaoId);
 
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, textureId);
-    // シェーダのサンプラーユニフォームに0をセット
-    glUniform1i(glGetUniformLocation(programId, "u_sampler"), 0);
-
-    struct SimpleVertex {
-        glm::vec2 pos;
-        glm::vec2 uv;
-    };
 
     if (selectingMode) {
         // 2D用の直交投影行列をセット
         glm::mat4 ortho = glm::ortho(0.0f, (float)WIN_WIDTH, 0.0f, (float)WIN_HEIGHT);
-        glUniformMatrix4fv(glGetUniformLocation(programId, "u_mvpMat"), 1, GL_FALSE, glm::value_ptr(ortho));
-        glUniform1i(glGetUniformLocation(programId, "u_mode"), 2);
-
-        // setting.pngをバインド
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, settingTexId);
-        glUniform1i(glGetUniformLocation(programId, "u_sampler"), 0);
+        program.set(uniforms.mvpMat, ortho);
+        program.set(uniforms.mode, 2);
 
-        int imgWidth = WIN_WIDTH;
-        int imgHeight = WIN_HEIGHT;
+        // setting.pngを縦横比を保って中央に置く
         float imgAspect = (float)settingImgWidth / settingImgHeight;
         float winAspect = (float)WIN_WIDTH / WIN_HEIGHT;
 
@@ -755,111 +1031,67 @@ void paintGL() {
             drawHeight = drawWidth / imgAspect;
         }
         float cx = WIN_WIDTH / 2.0f, cy = WIN_HEIGHT / 2.0f;
-        float x0 = cx - drawWidth / 2, x1 = cx + drawWidth / 2;
-        float y0 = cy - drawHeight / 2, y1 = cy + drawHeight / 2;
-        SimpleVertex quad[6] = {
-            { {x0, y0}, {0, 1} }, { {x1, y0}, {1, 1} }, { {x1, y1}, {1, 0} },
-            { {x0, y0}, {0, 1} }, { {x1, y1}, {1, 0} }, { {x0, y1}, {0, 0} }
-        };
-
-        struct SimpleVertex3D { glm::vec3 pos; glm::vec2 uv; };
-        SimpleVertex3D quad3d[6];
-        for (int i = 0; i < 6; ++i) {
-            quad3d[i].pos = glm::vec3(quad[i].pos, 0.0f);
-            quad3d[i].uv = quad[i].uv;
+        if (settingReady) {
+            spriteBatch.sprite(settingTexId, glm::vec2(cx - drawWidth / 2, cy - drawHeight / 2),
+                               glm::vec2(cx + drawWidth / 2, cy + drawHeight / 2));
+        } else {
+            // 画像のデコードが終わるまでは灰色の板 / Grey panel until the image has been decoded
+            spriteBatch.quad(glm::vec2(0.0f), glm::vec2((float)WIN_WIDTH, (float)WIN_HEIGHT), glm::vec4(0.2f, 0.2f, 0.2f, 1.0f));
         }
-
-        GLuint tmpVao, tmpVbo;
-        glGenVertexArrays(1, &tmpVao);
-        glGenBuffers(1, &tmpVbo);
-        glBindVertexArray(tmpVao);
-        glBindBuffer(GL_ARRAY_BUFFER, tmpVbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(quad3d), quad3d, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SimpleVertex3D), (void*)0);
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(SimpleVertex3D), (void*)(sizeof(glm::vec3)));
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glBindVertexArray(0);
-        glDeleteBuffers(1, &tmpVbo);
-        glDeleteVertexArrays(1, &tmpVao);
-
+        spriteBatch.flush();
         return;
     }
 
     // 3×3×3の小立方体を描画
-    // 各立方体ごとに36インデックスずつずらして描画
-    if (ArtMode) {
-        // 3x3x3個の小立方体ごとにデータ生成
-        int cubeIndex = 0;
+    // 小立方体の向きと位置は配置が変わった時だけuniformに転送する. 見える面は配置か回す層が変わった時だけ作り直す
+    // Cubie orientations and positions are uploaded only when the placements change; the visible
+    // faces are rebuilt only when the placements or the turning layer change
+    const int turn = rotating ? selectedAxis * 3 + selectedIndex : -1;
+    if (cubiesDirty) {
+        glm::ivec4 placements[NUM_CUBIES];
         for (int x = 0; x < 3; ++x) {
             for (int y = 0; y < 3; ++y) {
                 for (int z = 0; z < 3; ++z) {
-                    Cube& cube = cubes[x][y][z];
-                    glm::mat4 modelMat = acTransMat * globalRotMat * acRotMat * acScaleMat * cube.transform;
-                    modelMat = glm::scale(modelMat, glm::vec3(0.5f));
-                    glm::mat4 mvpMat = projMat * viewMat * modelMat;
-
-                    GLuint mvpMatLocId = glGetUniformLocation(programId, "u_mvpMat");
-                    glUniformMatrix4fv(mvpMatLocId, 1, GL_FALSE, glm::value_ptr(mvpMat));
-                    glUniform1i(glGetUniformLocation(programId, "u_selectID"), -1);
-                    glUniform1i(glGetUniformLocation(programId, "object"), 1);
-
-                    // 各面ごとに対応するテクスチャをバインドして描画
-                    for (int f = 0; f < 6; ++f) {
-                        glActiveTexture(GL_TEXTURE0);
-                        glBindTexture(GL_TEXTURE_2D, textureIds[f]);
-                        glUniform1i(glGetUniformLocation(programId, "u_sampler"), 0);
-                        glUniform1i(glGetUniformLocation(programId, "u_mode"), 1);
-
-                        // 1面=2三角形=6頂点
-                        int faceStart = (cubeIndex * 36) + (f * 6);
-                        glDrawElements(
-                            GL_TRIANGLES,
-                            6,
-                            GL_UNSIGNED_INT,
-                            (void*)(sizeof(unsigned int) * faceStart)
-                        );
-                    }
-                    ++cubeIndex;
+                    const Cube& cube = cubes[x][y][z];
+                    placements[x * 9 + y * 3 + z] = glm::ivec4(cube.logicalPos, cube.rotation);
                 }
             }
         }
-    } else {
-        int cubeIndex = 0;
-        for (int x = 0; x < 3; ++x) {
-            for (int y = 0; y < 3; ++y) {
-                for (int z = 0; z < 3; ++z) {
-                    // glm::mat4 modelMat = acTransMat * acRotMat * acScaleMat * cubeTransforms[x][y][z];
-                    // modelMat = glm::scale(modelMat, glm::vec3(0.5f));
-                    // glm::mat4 mvpMat = projMat * viewMat * modelMat;
-                    Cube& cube = cubes[x][y][z];
-                    glm::mat4 modelMat = acTransMat * globalRotMat * acRotMat * acScaleMat * cube.transform;
-                    modelMat = glm::scale(modelMat, glm::vec3(0.5f));
-                    glm::mat4 mvpMat = projMat * viewMat * modelMat;
-
+        program.set(uniforms.cubies, placements, NUM_CUBIES);
+    }
+    if (cubiesDirty || turn != visibleFacesTurn) {
+        updateVisibleFaces(rotating ? selectedAxis : -1, selectedIndex);
+        visibleFacesTurn = turn;
+        cubiesDirty = false;
+    }
 
+    // 全小立方体で共通の変換と, 回している層 (小立方体自身の配置はu_cubies)
+    // Transforms shared by every cubie and the turning layer (per-cubie placement is in u_cubies)
+    FrameMatrices frame;
+    frame.projMat = projMat;
+    frame.viewMat = viewMat;
+    frame.worldMat = cubeWorldMatrix();
+    frame.turnLayer = rotating ? glm::ivec4(selectedAxis, selectedIndex, 0, 0) : glm::ivec4(-1, 0, 0, 0);
+    frame.turnAngle = glm::vec4(glm::radians(rotationAngle), 0.0f, 0.0f, 0.0f);
+    frameBuffer.update(&frame, sizeof(frame));
+    program.set(uniforms.object, 1);
+    program.set(uniforms.readyFaces, readyFaces);
+    program.set(uniforms.iconReady, iconReady ? 1 : 0);
 
+    if (ArtMode) {
+        program.set(uniforms.mode, 1);
 
-                    GLuint mvpMatLocId = glGetUniformLocation(programId, "u_mvpMat");
-                    glUniformMatrix4fv(mvpMatLocId, 1, GL_FALSE, glm::value_ptr(mvpMat));
+        // 6面の画像は配列テクスチャのレイヤーとしてユニット1に置き, 面番号でレイヤーを選ぶ
+        // The face images live in one array texture on unit 1; the shader picks the layer by face
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, faceArrayTexId);
+        glActiveTexture(GL_TEXTURE0);
 
-                    GLuint uid = glGetUniformLocation(programId, "u_selectID");
-                    glUniform1i(uid, -1);
-                    glUniform1i(glGetUniformLocation(programId, "object"), 1);
-                    glUniform1i(glGetUniformLocation(programId, "u_mode"), 0);
+        glDrawElements(GL_TRIANGLES, visibleFaceCount * 6, GL_UNSIGNED_SHORT, (void*)0);
+    } else {
+        program.set(uniforms.mode, 0);
 
-                    // ここでインデックスバッファのオフセットを指定
-                    glDrawElements(
-                        GL_TRIANGLES,
-                        36,
-                        GL_UNSIGNED_INT,
-                        (void*)(sizeof(unsigned int) * 36 * cubeIndex)
-                    );
-                    ++cubeIndex;
-                }
-            }
-        }
+        glDrawElements(GL_TRIANGLES, visibleFaceCount * 6, GL_UNSIGNED_SHORT, (void*)0);
     }
 
 
@@ -870,6 +1102,8 @@ void paintGL() {
         glUseProgram(0);
         return;
     }
+    // 軸の円柱は内向きの帯なので両面を描く / The axis cylinders are inward-facing strips, so draw both sides
+    glDisable(GL_CULL_FACE);
     for (int i = 0; i < 3; ++i) {
         glm::vec3 axisColor;
         glm::mat4 model = glm::mat4(1.0f);
@@ -890,13 +1124,14 @@ void paintGL() {
         
         glm::mat4 mvp = projMat * viewMat * acTransMat * globalRotMat * acScaleMat * model;
 
-        glUniformMatrix4fv(glGetUniformLocation(programId, "u_mvpMat"), 1, GL_FALSE, glm::value_ptr(mvp));
-        glUniform3fv(glGetUniformLocation(programId, "u_color"), 1, glm::value_ptr(axisColor));
-        glUniform1i(glGetUniformLocation(programId, "object"), 0);
+        program.set(uniforms.mvpMat, mvp);
+        program.set(uniforms.color, axisColor);
+        program.set(uniforms.object, 0);
 
         glBindVertexArray(axisCylinderVao);
         glDrawArrays(GL_TRIANGLE_STRIP, 0, CYLINDER_SEGMENTS * 2 + 2);
     }
+    glEnable(GL_CULL_FACE);
     
 
 
@@ -931,51 +1166,233 @@ void resizeGL(GLFWwindow *window, int width, int height) {
 
     // 東映変換行列の更新
     // Update projection matrix
-    projMat = glm::perspective(glm::radians(45.0f), (float)WIN_WIDTH / (float)WIN_HEIGHT, 0.1f, 1000.0f);
+    projMat = glm::perspective(CAMERA_FOVY, (float)WIN_WIDTH / (float)WIN_HEIGHT, 0.1f, 1000.0f);
+    markDirty();
+}
+
+// ウィンドウの中身が失われた時 (他のウィンドウに隠された後など) のコールバック関数
+// Callback for when the window contents are damaged (e.g. after being covered)
+void refreshGL(GLFWwindow *window) {
+    markDirty();
+}
+
+// クリックで当たった小立方体と面
+// The cubie and face hit by a click
+struct PickResult {
+    glm::ivec3 home;      // 小立方体 (cubesの添字) / Cubie (index into cubes)
+    int face;             // キューブ全体から見た面の向き (面番号) / Face direction in the cube frame (face index)
+    bool sticker;         // 外側の面 (ステッカー) に当たったか / Whether an outer face (sticker) was hit
+    glm::ivec2 cell;      // 面の上のマス (stickerが真の時のみ) / Cell on the face (only if sticker)
+    glm::vec3 point;      // 当たった点 (キューブ座標) / Hit point in cube coordinates
+};
+PickResult lastPick;
+bool hasPick = false;
+
+// 軸と符号から面番号 (0:+X, 1:+Y, 2:+Z, 3:-Z, 4:-Y, 5:-X)
+// Face index from an axis and a sign
+int faceFromAxis(int axis, float sign) {
+    return sign > 0.0f ? axis : 5 - axis;
+}
+
+// 面の上のマス. シェーダのstickerCellと同じ並び
+// Cell of a position on a face, in the same layout as stickerCell in the shader
+glm::ivec2 stickerCell(int face, const glm::ivec3 &p) {
+    switch (face) {
+    case 0: return glm::ivec2(2 - p.z, 2 - p.y);
+    case 1: return glm::ivec2(p.x, p.z);
+    case 2: return glm::ivec2(p.x, 2 - p.y);
+    case 3: return glm::ivec2(2 - p.x, 2 - p.y);
+    case 4: return glm::ivec2(p.x, 2 - p.z);
+    default: return glm::ivec2(p.z, 2 - p.y);
+    }
+}
+
+// カーソル位置を通る視線をCPUで小立方体の箱と交差させる (GPUからの読み戻しは不要)
+// Cast a ray through the cursor and intersect it with the cubie boxes on the CPU (no GPU readback)
+bool pickCubie(double px, double py, PickResult &result) {
+    // カーソル位置の視線をキューブ座標 (全体の変換を掛ける前) で求める
+    // Ray through the cursor, in cube coordinates (before the whole-cube transform)
+    const float ndcX = 2.0f * (float)px / (float)WIN_WIDTH - 1.0f;
+    const float ndcY = 1.0f - 2.0f * (float)py / (float)WIN_HEIGHT;
+    const glm::mat4 invMat = glm::inverse(projMat * viewMat * cubeWorldMatrix());
+    glm::vec4 nearPt = invMat * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+    glm::vec4 farPt = invMat * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+    const glm::vec3 origin = glm::vec3(nearPt) / nearPt.w;
+    const glm::vec3 dir = glm::vec3(farPt) / farPt.w - origin;
+
+    float bestT = std::numeric_limits<float>::max();
+    bool hit = false;
+    for (int x = 0; x < 3; ++x) {
+        for (int y = 0; y < 3; ++y) {
+            for (int z = 0; z < 3; ++z) {
+                // 小立方体の局所座標では箱は[-0.5, 0.5]^3 (描画時のscale 0.5を含む)
+                // In cubie space the box is [-0.5, 0.5]^3 (including the 0.5 scale used for drawing)
+                const glm::mat4 M = cubieTransform(glm::ivec3(x, y, z));
+                const glm::mat4 invM = glm::inverse(M);
+                const glm::vec3 o = glm::vec3(invM * glm::vec4(origin, 1.0f));
+                const glm::vec3 d = glm::vec3(invM * glm::vec4(dir, 0.0f));
+
+                // スラブ法 / Slab test
+                float tNear = -std::numeric_limits<float>::max(), tFar = std::numeric_limits<float>::max();
+                int nearAxis = 0;
+                bool miss = false;
+                for (int a = 0; a < 3 && !miss; ++a) {
+                    if (std::abs(d[a]) < 1.0e-8f) {
+                        miss = std::abs(o[a]) > 0.5f;
+                        continue;
+                    }
+                    float t0 = (-0.5f - o[a]) / d[a];
+                    float t1 = (0.5f - o[a]) / d[a];
+                    if (t0 > t1) std::swap(t0, t1);
+                    if (t0 > tNear) {
+                        tNear = t0;
+                        nearAxis = a;
+                    }
+                    tFar = std::min(tFar, t1);
+                    miss = tNear > tFar;
+                }
+                if (miss || tFar < 0.0f || tNear < 0.0f || tNear >= bestT) continue;
+
+                bestT = tNear;
+                hit = true;
+                const glm::vec3 localPoint = o + d * tNear;
+                result.home = glm::ivec3(x, y, z);
+                glm::vec3 n(0.0f);
+                n[nearAxis] = localPoint[nearAxis] > 0.0f ? 1.0f : -1.0f;
+                const glm::vec3 cubeNormal = glm::vec3(M * glm::vec4(n, 0.0f));
+                int axis = 0;
+                for (int a = 1; a < 3; ++a) {
+                    if (std::abs(cubeNormal[a]) > std::abs(cubeNormal[axis])) axis = a;
+                }
+                result.face = faceFromAxis(axis, cubeNormal[axis]);
+                result.point = origin + dir * tNear;
+            }
+        }
+    }
+    if (!hit) return false;
+
+    // 外側を向いた面ならステッカー / A face pointing outwards is a sticker
+    const glm::ivec3 pos = cubes[result.home.x][result.home.y][result.home.z].logicalPos;
+    const int axis = result.face < 3 ? result.face : 5 - result.face;
+    result.sticker = pos[axis] == (result.face < 3 ? 2 : 0);
+    result.cell = result.sticker ? stickerCell(result.face, pos) : glm::ivec2(-1);
+    return true;
+}
+
+
+// ステッカーをドラッグして層を回す操作
+// Turning a layer by dragging one of its stickers
+struct LayerDrag {
+    bool pending = false;   // ステッカーを押している (軸はまだ決まっていないかもしれない) / A sticker is held
+    glm::vec2 pressPos;     // 押した位置 / Cursor position at the press
+    glm::vec2 tangent;      // 層を1ラジアン回した時のカーソルの動き (ピクセル) / Cursor motion per radian of the layer
+};
+LayerDrag layerDrag;
+static const float DRAG_START_DISTANCE = 6.0f;  // 軸を決めるまでに動かす距離 (ピクセル) / Drag distance before the axis is chosen
+
+// キューブ座標の点のウィンドウ上の位置 / Window position of a point in cube coordinates
+glm::vec2 projectToWindow(const glm::vec3 &cubePoint) {
+    const glm::vec4 clip = projMat * viewMat * cubeWorldMatrix() * glm::vec4(cubePoint, 1.0f);
+    const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+    return glm::vec2((ndc.x + 1.0f) * 0.5f * WIN_WIDTH, (1.0f - ndc.y) * 0.5f * WIN_HEIGHT);
 }
 
+// 押したステッカーを回せる2つの軸のうち, ドラッグの向きに近い方を選んで層をつかむ
+// Of the two axes that can move the held sticker, pick the one closest to the drag and grab that layer
+bool beginLayerDrag(const glm::vec2 &drag) {
+    const int faceAxis = lastPick.face < 3 ? lastPick.face : 5 - lastPick.face;
+    const glm::ivec3 pos = cubes[lastPick.home.x][lastPick.home.y][lastPick.home.z].logicalPos;
+    const glm::vec2 p0 = projectToWindow(lastPick.point);
+    const glm::vec2 dragDir = glm::normalize(drag);
+
+    int bestAxis = -1;
+    float bestScore = 0.0f;
+    glm::vec2 bestTangent(0.0f);
+    for (int a = 0; a < 3; ++a) {
+        if (a == faceAxis) continue;
+
+        // 軸aまわりに少し回した時の, 当たった点の画面上の動き
+        // Screen motion of the hit point for a small turn about axis a
+        glm::vec3 e(0.0f);
+        e[a] = 1.0f;
+        const float eps = 0.01f;
+        const glm::vec2 t = (projectToWindow(lastPick.point + eps * glm::cross(e, lastPick.point)) - p0) / eps;
+        const float len = glm::length(t);
+        if (len < 1.0e-3f) continue;
+
+        const float score = std::abs(glm::dot(t / len, dragDir));
+        if (score > bestScore) {
+            bestScore = score;
+            bestAxis = a;
+            bestTangent = t;
+        }
+    }
+    if (bestAxis < 0) return false;
+
+    selectedAxis = bestAxis;
+    selectedIndex = pos[bestAxis];
+    layerDrag.tangent = bestTangent;
+    rotationAngle = 0.0f;
+    rotating = true;
+    layerDragging = true;
+    return true;
+}
+
+// カーソルの動きを層の回転角に直す / Turn the cursor motion into the layer angle
+void updateLayerDrag(const glm::vec2 &cursor) {
+    const glm::vec2 drag = cursor - layerDrag.pressPos;
+    const float radians = glm::dot(drag, layerDrag.tangent) / glm::dot(layerDrag.tangent, layerDrag.tangent);
+    setLayerAngle(glm::degrees(radians));
+}
+
+// 離したら最も近い1/4回転の角度まで回し切る (0なら元に戻る)
+// On release, finish the turn at the nearest multiple of 90 degrees (zero returns the layer)
+void endLayerDrag() {
+    const int quarters = (int)std::round(rotationAngle / 90.0f);
+    clockwise = quarters >= 0;
+    turnQuarters = std::abs(quarters);
+    turnFromAngle = rotationAngle;
+    turnToAngle = quarters * 90.0f;
+    currentTurnDuration = turnDuration * std::min(1.0f, std::abs(turnToAngle - turnFromAngle) / 90.0f);
+    rotationStartTime = glfwGetTime();
+    layerDragging = false;
+}
+
+
 // マウスのクリックを処理するコールバック関数
 // Callback for mouse click events
 void mouseEvent(GLFWwindow *window, int button, int action, int mods) {
 
     double px, py;
     glfwGetCursorPos(window, &px, &py);
-    const int cx = (int)px;
-    const int cy = (int)py;
 
     if (selectingMode && action == GLFW_PRESS) {
         // モード選択中のクリック処理
         double px, py;
         glfwGetCursorPos(window, &px, &py);
-        if (px < WIN_WIDTH / 2 && py > WIN_HEIGHT / 9 * 7 && py < WIN_HEIGHT / 9 * 8) {
-            ArtMode = false;
-            selectingMode = false;
-        } else if (px >= WIN_WIDTH / 2 && py > WIN_HEIGHT / 9 * 7 && py < WIN_HEIGHT / 9 * 8) {
-            ArtMode = true;
-            selectingMode = false;
+        if (py > WIN_HEIGHT / 9 * 7 && py < WIN_HEIGHT / 9 * 8) {
+            // ボタンが押された時だけモードを切り替える / Switch only when a button is hit
+            selectMode(px >= WIN_WIDTH / 2);
         }
-        
-        // 再初期化
-        initializeGL();
         return;
     }
 
     if (action == GLFW_PRESS) {
-        // クリック位置で選択判定
-        // 選択モードでの描画
-        selectMode = true;
-        paintGL();
-        selectMode = false;
-
-        // ピクセルの大きさの計算 (Macの場合には必要)
-        int renderBufferWidth, renderBufferHeight;
-        glfwGetFramebufferSize(window, &renderBufferWidth, &renderBufferHeight);
-        int pixelSize = std::max(renderBufferWidth / WIN_WIDTH, renderBufferHeight / WIN_HEIGHT);
-
-        // より適切なやり方 (1ピクセルだけを読む)
-        unsigned char byte[4];
-        glReadPixels(cx * pixelSize, (WIN_HEIGHT - cy - 1) * pixelSize, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, byte);
-        // printf("Select object %d\n", (int)byte[0]);
+        // クリック位置の小立方体をCPUで求める
+        // Find the clicked cubie on the CPU
+        hasPick = pickCubie(px, py, lastPick);
+
+        // ステッカーを左ボタンで押したら, キューブ全体ではなく層を回す
+        // Left-pressing a sticker turns a layer instead of the whole cube
+        if (button == GLFW_MOUSE_BUTTON_LEFT && hasPick && lastPick.sticker && !rotating && moveQueue.empty()) {
+            if (solver.status() == AsyncSolver::SEARCHING) {
+                solver.cancel();
+                printf("Solve cancelled.\n");
+            }
+            layerDrag.pending = true;
+            layerDrag.pressPos = glm::vec2(px, py);
+            return;
+        }
 
         // ここでドラッグ開始
         isDragging = true;
@@ -991,6 +1408,11 @@ void mouseEvent(GLFWwindow *window, int button, int action, int mods) {
             arcballMode = ARCBALL_MODE_TRANSLATE;
         }
     } else if (action == GLFW_RELEASE) {
+        if (layerDrag.pending) {
+            layerDrag.pending = false;
+            if (layerDragging) endLayerDrag();
+            return;
+        }
         isDragging = false;
         oldPos = glm::ivec2(0, 0);
         newPos = glm::ivec2(0, 0);
@@ -1039,6 +1461,7 @@ void updateRotate() {
 
     // 回転行列をグローバルに適用
     globalRotMat = glm::rotate((float)(2.0 * angle), rotAxisWorld) * globalRotMat;
+    markDirty();
 }
 
 
@@ -1099,6 +1522,7 @@ void updateTransform() {
 
     case ARCBALL_MODE_SCALE:
         acScale += (float)(oldPos.y - newPos.y) / WIN_HEIGHT;
+        markDirty();
         // updateScale();
         break;
     }
@@ -1107,6 +1531,17 @@ void updateTransform() {
 // マウスの動きを処理するコールバック関数
 // Callback for mouse move events
 void motionEvent(GLFWwindow *window, double xpos, double ypos) {
+    if (layerDrag.pending) {
+        // 十分動いたら回す軸を決め, その後は層がカーソルに付いてくる
+        // Choose the axis once the cursor has moved far enough; then the layer follows the cursor
+        const glm::vec2 cursor((float)xpos, (float)ypos);
+        if (!rotating && glm::length(cursor - layerDrag.pressPos) >= DRAG_START_DISTANCE) {
+            if (!beginLayerDrag(cursor - layerDrag.pressPos)) layerDrag.pending = false;
+        }
+        if (layerDragging) updateLayerDrag(cursor);
+        return;
+    }
+
     if (isDragging) {
         // マウスの現在位置を更新
         // Update current mouse position
@@ -1133,54 +1568,211 @@ void motionEvent(GLFWwindow *window, double xpos, double ypos) {
 //     // updateScale();
 // }
 
-bool rotating = false;
-float rotationAngle = 0.0f;
 // Shuffle operations
-// グローバル
-struct ShuffleMove {
-    int axis;
-    int index;
-    bool clockwise;
-};
-std::vector<ShuffleMove> shuffleMoves;
-bool isShuffling = false;
+// 手を待ち行列に積む. 満杯なら捨てて知らせる
+// Queue a move; report and drop it if the queue is full
+void queueMove(CubeMove move) {
+    if (!moveQueue.push(move)) {
+        printf("Move queue is full, move dropped.\n");
+    }
+}
 
-void startShuffle(int numMoves = 30) {
-    shuffleMoves.clear();
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> axisDist(0, 2);
-    std::uniform_int_distribution<> indexDist(0, 2);
-    std::uniform_int_distribution<> dirDist(0, 1);
-
-    for (int i = 0; i < numMoves; ++i) {
-        ShuffleMove move;
-        move.axis = axisDist(gen);
-        move.index = indexDist(gen);
-        move.clockwise = dirDist(gen) == 0;
-        shuffleMoves.push_back(move);
+// スクランブルの種. 起動時に --seed で指定すると再現できる (1回ごとに1ずつ進む)
+// Scramble seed; pass --seed at startup for reproducible scrambles (advances by one per scramble)
+uint64_t scrambleSeed = 0;
+
+// スクランブルの探索 (初回は表の生成も) は別スレッドで行い, 描画を止めない.
+// できあがったらpollScrambler()が再生するか, 一度に適用する
+// Scramble searches (and table generation on first use) run on a worker so rendering
+// never stalls; pollScrambler() plays or applies the result once it is ready.
+AsyncScrambler scrambler;
+bool scrambleInstant = false;
+
+// 一様ランダムな状態へのスクランブルを作り始める. ArtModeではセンターの向きも混ぜる
+// 準備中 (初回は表の生成中) にもう一度押すとやめる
+// Start building a scramble to a uniformly random state; ArtMode also randomises centre orientations.
+// Pressing again while one is being prepared (on first use, while the tables are built) cancels it
+void requestScramble(bool instant) {
+    if (scrambler.status() == AsyncScrambler::SEARCHING) {
+        scrambler.cancel();
+        printf("Scramble cancelled.\n");
+        return;
     }
+    scrambleInstant = instant;
+    scrambler.start(scrambleSeed++, ArtMode, SOLVER_TABLE_FILE);
+}
 
+// 手順をシャッフルと同じ仕組みで1手ずつアニメーションさせる
+// Animate a move sequence one move at a time, the same way as a shuffle
+void startMoveSequence(const std::vector<CubeMove> &moves, const std::string &name) {
+    for (CubeMove m : moves) queueMove(m);
+    shuffleName = name;
     isShuffling = true;
-    rotating = false; // すぐ1手目を開始できるように
+}
+
+// 手の列をアニメーションなしで論理モデルに一度に適用し, 描画用の変換を1回だけ作り直す
+// 回転中の手と待ち行列の手は先に (これもアニメーションなしで) 済ませる
+// Apply a whole move sequence to the logical model at once, without animation, and rebuild
+// the cubie transforms only once. The turn in progress and any queued moves are applied first.
+void applyMovesInstantly(const CubeMove *moves, int count) {
+    if (rotating) {
+        // つかんでいる層は離したことにして元に戻す / A dragged layer is dropped back in place
+        if (layerDragging) turnQuarters = 0;
+        for (int i = 0; i < turnQuarters; ++i) cubeState.apply(makeMove(selectedAxis, selectedIndex, clockwise));
+        rotating = false;
+        layerDragging = false;
+    }
+    CubeMove pending;
+    while (moveQueue.pop(pending)) cubeState.apply(pending);
+
+    cubeState.apply(moves, count);
+    syncCubesFromState();
+}
+
+void applyMovesInstantly(const std::vector<CubeMove> &moves) {
+    applyMovesInstantly(moves.data(), (int)moves.size());
+}
+
+bool solveHintOnly = false;
+int solveReportedLength = -1;
+static const double SOLVE_TIME_LIMIT = 1.0;  // より短い解を探し続ける時間 (秒) / Time spent improving the solution (s)
+
+// 現在の状態を解き始める. ヒントなら最初の1手だけ, そうでなければ全手順を再生する
+// ArtModeでは面の絵の向きも揃える必要があるのでセンターの向きも戻す
+// Start solving the current state; a hint plays the first move, otherwise the whole solution.
+// ArtMode also restores the centre orientations so the pictures line up again.
+void startSolve(bool hintOnly) {
+    // 表は初回だけワーカーで読み込む (キャッシュが無ければ生成して保存する)
+    // Tables are loaded by the worker on first use (generated and cached if missing)
+    solveHintOnly = hintOnly;
+    solveReportedLength = -1;
+    solver.start(cubeState, ArtMode, SOLVER_TABLE_FILE, SOLVE_TIME_LIMIT);
+    printf("Solving...\n");
+}
+
+// 毎フレーム呼び, 短い解が見つかれば表示し, 探索が終われば手順を再生する
+// Called every frame: report shorter solutions as they arrive and play the best one when done
+void pollSolver() {
+    if (solver.status() == AsyncSolver::IDLE) return;
+
+    std::vector<CubeMove> moves;
+    const int length = solver.best(&moves);
+    if (length != solveReportedLength) {
+        printf("Solution: %d moves\n", length);
+        solveReportedLength = length;
+    }
+    if (solver.status() != AsyncSolver::DONE) return;
+    solver.reset();
+
+    if (length < 0) {
+        printf("No solution found.\n");
+        return;
+    }
+    if (moves.empty()) {
+        printf("Already solved.\n");
+        return;
+    }
+    if (solveHintOnly) moves.resize(1);
+    startMoveSequence(moves, solveHintOnly ? "Hint" : "Solve");
+}
+
+// 毎フレーム呼び, スクランブルができていれば再生する (即時なら一度に適用する).
+// 回転中や待ち行列の手があれば, それを回し終えてから1手目を始める
+// Called every frame: once a scramble is ready, play it (or apply it at once if instant).
+// Turns already in progress or queued finish before its first move starts.
+void pollScrambler() {
+    if (scrambler.status() != AsyncScrambler::DONE) return;
+
+    const uint64_t seed = scrambler.seed();
+    std::vector<CubeMove> moves;
+    if (!scrambler.take(moves)) {
+        printf("No scramble found (seed %llu).\n", (unsigned long long)seed);
+        return;
+    }
+    printf("Scramble (seed %llu): %s\n", (unsigned long long)seed, formatMoves(moves).c_str());
+    if (scrambleInstant) {
+        applyMovesInstantly(moves);
+        printf("Instant shuffle done.\n");
+    } else {
+        startMoveSequence(moves, "Shuffle");
+        printf("Shuffling starts!\n");
+    }
+}
+
+// 画素の読み戻しはPBOで非同期に行う (スクリーンショットなど)
+// Pixel reads go through asynchronous PBO readback (screenshots etc.)
+ReadbackService readback;
+bool screenshotRequested = false;
+int screenshotCount = 0;
+// 書き込み中のスレッド. 途中のファイルを残さないよう終了時に待つ
+// Writer threads; joined at exit so no half-written file is left behind
+std::vector<std::thread> screenshotWriters;
+
+// 読み戻した画素をPPM画像として保存する. 書き込みは別スレッドで行い描画を止めない
+// Save read-back pixels as a PPM image; the file is written on another thread so rendering never waits
+void saveScreenshot(int width, int height, const std::vector<unsigned char> &rgba) {
+    const std::string filename = std::string(SOURCE_DIRECTORY) + "screenshot_" + std::to_string(screenshotCount++) + ".ppm";
+    screenshotWriters.emplace_back([filename, width, height, rgba]() {
+        std::ofstream writer(filename, std::ios::binary);
+        if (!writer.is_open()) {
+            fprintf(stderr, "Failed to write screenshot: %s\n", filename.c_str());
+            return;
+        }
+        writer << "P6\n" << width << " " << height << "\n255\n";
+        // OpenGLの画素は下の行から並んでいる / OpenGL rows start at the bottom
+        std::vector<char> row(width * 3);
+        for (int y = height - 1; y >= 0; --y) {
+            for (int x = 0; x < width; ++x) {
+                for (int c = 0; c < 3; ++c) row[x * 3 + c] = (char)rgba[(y * width + x) * 4 + c];
+            }
+            writer.write(row.data(), row.size());
+        }
+        printf("Saved %s\n", filename.c_str());
+    });
 }
 
 bool clockwise_w = true; // Wキーの状態を管理
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
 
-    if (action == GLFW_PRESS && key == GLFW_KEY_S && mods && GLFW_MOD_CONTROL) {
+    // 探索中に何かキーが押されたら探索をやめる (Hならそれだけで終わる)
+    // Any key press cancels a running search (H then only cancels)
+    if (action == GLFW_PRESS && solver.status() == AsyncSolver::SEARCHING) {
+        solver.cancel();
+        printf("Solve cancelled.\n");
+        if (key == GLFW_KEY_H) return;
+    }
+
+    if (action == GLFW_PRESS && key == GLFW_KEY_S &&
+        (mods & (GLFW_MOD_CONTROL | GLFW_MOD_SUPER)) && (mods & GLFW_MOD_SHIFT)) {
+        // Command (Ctrl) + Shift + S でアニメーションなしの即時シャッフル
+        // Command (Ctrl) + Shift + S scrambles instantly, without animation
+        requestScramble(true);
+        return;
+    }
+
+    if (action == GLFW_PRESS && key == GLFW_KEY_S && (mods & (GLFW_MOD_CONTROL | GLFW_MOD_SUPER))) {
         // Ctrl + S でシャッフル開始
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<int> dist(25, 35);
-        int random_num = dist(gen);
-        startShuffle(random_num); // 25~35手シャッフル
-        // printf("Shuffling started with %d moves.\n", random_num);
-        printf("Shuffling starts!\n");
+        requestScramble(false); // 一様ランダムな状態へのシャッフル
     }
 
 
+    // Pでスクリーンショット (次の描画の後に読み戻す)
+    // P takes a screenshot (read back after the next frame is drawn)
+    if (action == GLFW_PRESS && key == GLFW_KEY_P) {
+        screenshotRequested = true;
+        markDirty();  // 読み戻すフレームを描かせる / Make sure a frame is drawn to read back
+        return;
+    }
+
+    // Hでヒント (次の1手), Shift + Hで解く
+    // H shows a hint (next move), Shift + H solves the cube
+    // 解くのは全ての手を回し終えた状態 / Only solve once every queued move has been played
+    if (action == GLFW_PRESS && key == GLFW_KEY_H && !rotating && moveQueue.empty()) {
+        startSolve((mods & GLFW_MOD_SHIFT) == 0);
+        return;
+    }
+
     // Wキーの押下・離上でclockwiseを切り替え
     if (key == GLFW_KEY_W) {
         if (action == GLFW_PRESS) {
@@ -1191,61 +1783,46 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
         }
     }
     
-    if (action == GLFW_PRESS && !rotating) {
+    // 回転中に押されたキーも待ち行列に積み, 取りこぼさない
+    // Keys pressed during a turn are queued rather than dropped
+    if (action == GLFW_PRESS) {
+        int axis = -1;
+        int index = 2;
 
         if (mods & GLFW_MOD_SUPER) {
-            // Ctrlキーが押されている場合は回転を開始
-            selectedIndex= 0;
-        } else {
-            // Ctrlキーが押されていない場合は回転を停止
-            selectedIndex = 2;
+            // Commandキーが押されている場合は遠い側の面
+            index = 0;
         }
 
-        if (mods & GLFW_MOD_ALT || (GLFW_PRESS && key == GLFW_KEY_S && mods && GLFW_MOD_CONTROL)) {
+        if (mods & GLFW_MOD_ALT || (GLFW_PRESS && key == GLFW_KEY_S && (mods & (GLFW_MOD_CONTROL | GLFW_MOD_SUPER)))) {
             // Altキーが押されている時とshuffle時は非表示
             AxisVisible = false;
         } else {
             AxisVisible = true;
         }
+        markDirty();
 
         if (key == GLFW_KEY_B) {
-            selectedAxis = 2;        // Z軸
-            // selectedIndex = 2;       // z=0 面
-            rotating = true;
-            rotationAngle = 0.0f;
-            clockwise = clockwise_w;  // 時計回り
+            axis = 2;        // Z軸
         } else if (key == GLFW_KEY_V) {
-            selectedAxis = 2;
-            selectedIndex = 1;
-            rotating = true;
-            rotationAngle = 0.0f;
-            clockwise = clockwise_w;
+            axis = 2;
+            index = 1;
         }
         // 必要に応じて他のキーにも追加（x, y 軸用など）
         else if (key == GLFW_KEY_G) {
-            selectedAxis = 1;
-            // selectedIndex = 2;
-            rotating = true;
-            rotationAngle = 0.0f;
-            clockwise = clockwise_w;  // 時計回り
+            axis = 1;
         } else if (key == GLFW_KEY_F) {
-            selectedAxis = 1;
-            selectedIndex = 1;
-            rotating = true;
-            rotationAngle = 0.0f;
-            clockwise = clockwise_w;  // 時計回り
+            axis = 1;
+            index = 1;
         } else if (key == GLFW_KEY_R) {
-            selectedAxis = 0;
-            // selectedIndex = 2;
-            rotating = true;
-            rotationAngle = 0.0f;
-            clockwise = clockwise_w;  // 時計回り
+            axis = 0;
         } else if (key == GLFW_KEY_E) {
-            selectedAxis = 0;
-            selectedIndex = 1;
-            rotating = true;
-            rotationAngle = 0.0f;
-            clockwise = clockwise_w;  // 時計回り
+            axis = 0;
+            index = 1;
+        }
+
+        if (axis >= 0) {
+            queueMove(makeMove(axis, index, clockwise_w));
         }
     }
 }
@@ -1253,72 +1830,84 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 
 
 void update() {
-    if (isShuffling) {
-        if (!rotating && !shuffleMoves.empty()) {
-            // 次の手を開始
-            ShuffleMove move = shuffleMoves.front();
-            shuffleMoves.erase(shuffleMoves.begin());
-            selectedAxis = move.axis;
-            selectedIndex = move.index;
-            clockwise = move.clockwise;
-            rotationAngle = 0.0f;
-            rotating = true;
-        }
-        if (rotating) {
-            float angleStep = clockwise ? 3.0f : -3.0f;
-            rotationAngle += angleStep;
-            if ((clockwise && rotationAngle > 90.0f) || (!clockwise && rotationAngle < -90.0f)) {
-                rotating = false;
-            }
-            applyRotation(selectedAxis, selectedIndex, angleStep, rotationAngle, rotating);
-        }
-        // シャッフル終了
-        if (!rotating && shuffleMoves.empty()) {
-            isShuffling = false;
-            AxisVisible = true; // シャッフル終了時に軸を表示
-            std::cout << "Shuffle completed." << std::endl;
-        }
-        return;
+    pollSolver();
+    pollScrambler();
+
+    // 待ち行列から次の手を始める
+    // Start the next queued move
+    CubeMove move;
+    if (!rotating && moveQueue.pop(move)) {
+        startTurn(moveAxis(move), moveIndex(move), moveClockwise(move));
     }
+    advanceTurn();
+
+    // シャッフル終了
+    if (isShuffling && !rotating && moveQueue.empty()) {
+        isShuffling = false;
+        AxisVisible = true; // シャッフル終了時に軸を表示
+        markDirty();
+        std::cout << shuffleName << " completed." << std::endl;
+    }
+}
 
-    if (!rotating) return;
-    float angleStep = 0.0f;
-
-    if (clockwise) {
-        angleStep = 3.0f;
-        
-        rotationAngle += angleStep;
-        // std::cout << "Rotation angle: " << rotationAngle << std::endl;
-
-        if (rotationAngle > 90.0f) {
-            // angleStep -= (rotationAngle - 90.0f);  // 最後のステップ調整
-            rotating = false;
+// GLのオブジェクトを全て削除する (ウィンドウを閉じる前に呼ぶ)
+// Delete every GL object (call before the window is destroyed)
+void releaseGL() {
+    // 転送待ちの画像はもう要らない / Images still waiting for upload are no longer needed
+    imageLoader.shutdown();
+    resources.clear();
+    textureId = settingTexId = faceArrayTexId = 0;
+    vaoId.reset();
+    vertexBufferId.reset();
+    indexBufferId.reset();
+    axisCylinderVao.reset();
+    axisCylinderVbo.reset();
+    program = ShaderProgram();
+    frameBuffer.release();
+    spriteBatch.release();
+    readback.release();
+
+    // 書きかけのスクリーンショットを最後まで書く / Finish screenshots still being written
+    for (std::thread &writer : screenshotWriters) writer.join();
+    screenshotWriters.clear();
+}
 
+int main(int argc, char **argv) {
+    // コマンドライン引数
+    // --seed <n>      : スクランブルの種を固定する / Fix the scramble seed
+    // --scrambles <n> : n個のスクランブルを全コアで作って表示し, 終了する / Print n scrambles and exit
+    // --art           : --scramblesでセンターの向きも混ぜる (ArtMode用. かなり遅い)
+    //                   Randomise centre orientations too with --scrambles (for ArtMode; much slower)
+    std::random_device rd;
+    scrambleSeed = ((uint64_t)rd() << 32) | rd();
+    int bulkScrambles = 0;
+    bool bulkArt = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (option == "--seed" && i + 1 < argc) {
+            scrambleSeed = std::stoull(argv[++i]);
+        } else if (option == "--scrambles" && i + 1 < argc) {
+            bulkScrambles = std::stoi(argv[++i]);
+        } else if (option == "--art") {
+            bulkArt = true;
         }
-    } else {
-        angleStep = -3.0f;
-        
-        rotationAngle += angleStep;
-        // std::cout << "Rotation angle: " << rotationAngle << std::endl;
-
-        if (rotationAngle < -90.0f) {
-            // angleStep -= (rotationAngle + 90.0f);  // 最後のステップ調整
-            rotating = false;
+    }
+    if (bulkScrambles > 0) {
+        initSolverTables(SOLVER_TABLE_FILE);
+        std::vector<std::vector<CubeMove>> scrambles;
+        randomScrambles(scrambleSeed, bulkScrambles, bulkArt, scrambles);
+        for (int i = 0; i < bulkScrambles; ++i) {
+            printf("%llu: %s\n", (unsigned long long)(scrambleSeed + i), formatMoves(scrambles[i]).c_str());
         }
+        return 0;
     }
-    // std::cout << "Rotating around axis: " << selectedAxis << ", index: " << selectedIndex << ", angle: " << rotationAngle << std::endl;
 
-    applyRotation(selectedAxis, selectedIndex, angleStep, rotationAngle, rotating);
-}
-
-
-// アニメーションのためのアップデート
-// Update parameters for animation
-void animate() {
-    theta += 1.0f;  // 1度だけ回転 / Rotate 1 degree of angle
-}
+    // アセットパックをマップする. 無ければ個別のファイルだけを使う
+    // Map the asset pack; without one, only loose files are used
+    if (assets.open(ASSET_PACK_FILE)) {
+        printf("Asset pack: %s (%d files)\n", ASSET_PACK_FILE, assets.entryCount());
+    }
 
-int main(int argc, char **argv) {
     // OpenGLを初期化する
     // OpenGL initialization
     if (glfwInit() == GLFW_FALSE) {
@@ -1360,6 +1949,7 @@ int main(int argc, char **argv) {
     // ウィンドウのリサイズを扱う関数の登録
     // Register a callback function for window resizing
     glfwSetWindowSizeCallback(window, resizeGL);
+    glfwSetWindowRefreshCallback(window, refreshGL);
 
     // マウスのイベントを処理する関数を登録
     // Register a callback function for mouse click events
@@ -1384,20 +1974,57 @@ int main(int argc, char **argv) {
 
     // メインループ
     while (glfwWindowShouldClose(window) == GLFW_FALSE) {
+        // デコードの終わった画像を転送する / Upload images whose decoding has finished
+        imageLoader.poll();
+
         update();  // アニメーションの更新
-        // 描画 / Draw
-        paintGL();
 
-        // アニメーション / Animation
-        animate();
+        // 回している途中 (マウスで層をつかんでいる間は除く) か, 次の手が待っている
+        // A turn is playing (not held by a mouse drag) or more moves are waiting
+        const bool animating = (rotating && !layerDragging) || !moveQueue.empty();
+
+        // 何か変わった時だけ描く / Draw only when something changed
+        if (sceneDirty || animating) {
+            sceneDirty = false;
 
-        // 描画用バッファの切り替え
-        // Swap drawing target buffers
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+            // 描画 / Draw
+            paintGL();
+
+            // 画素の読み戻しは要求だけ積み, 結果は後のフレームで受け取る
+            // Pixel reads are only queued here; results arrive in a later frame
+            if (screenshotRequested) {
+                int renderBufferWidth, renderBufferHeight;
+                glfwGetFramebufferSize(window, &renderBufferWidth, &renderBufferHeight);
+                readback.read(0, 0, renderBufferWidth, renderBufferHeight, saveScreenshot);
+                screenshotRequested = false;
+            }
+
+            // 描画用バッファの切り替え
+            // Swap drawing target buffers
+            glfwSwapBuffers(window);
+        }
+        readback.poll();
+
+        // アニメーション中は待たずに次のフレームへ. 止まっている間はイベントが来るまで眠る
+        // (探索, 読み戻し, 画像のデコードが終わるのを待つ間は短い間隔で起きる)
+        // Keep going while animating; otherwise sleep until an event arrives
+        // (waking at a short interval while a search, readback or image decode is still running)
+        if (animating || sceneDirty) {
+            glfwPollEvents();
+        } else if (solver.status() == AsyncSolver::SEARCHING || scrambler.status() == AsyncScrambler::SEARCHING ||
+                   readback.pending() > 0 || imageLoader.pending() > 0) {
+            glfwWaitEventsTimeout(BACKGROUND_POLL_INTERVAL);
+        } else {
+            glfwWaitEventsTimeout(IDLE_WAIT_TIMEOUT);
+        }
     }
 
     // 後処理 / Postprocess
+    // ワーカーは他のファイルの静的変数 (ソルバーの表) を使うので, 静的変数が破棄される前に止める
+    // Workers use statics from other files (the solver tables), so stop them before static destruction
+    solver.shutdown();
+    scrambler.shutdown();
+    releaseGL();
     glfwDestroyWindow(window);
     glfwTerminate();
 }
\ No newline at end of file
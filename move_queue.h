@@ -0,0 +1,56 @@
+#ifndef _MOVE_QUEUE_H_
+#define _MOVE_QUEUE_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include "cube_state.h"
+
+// 回す手を溜めておく固定長のリングバッファ (ロックなし)
+// 書き込み側 (キー入力など) と読み出し側 (update) がそれぞれ1つずつなら,
+// 別スレッドからでも安全に使える. 先頭の取り出しはO(1)
+// Fixed-size lock-free ring buffer of pending moves. It is safe for one producer
+// (key input etc.) and one consumer (update), even on different threads.
+// Popping the front is O(1).
+class MoveQueue {
+public:
+    static const uint32_t CAPACITY = 1024;  // 2のべき乗 / Must be a power of two
+
+    // 末尾に追加する. 満杯ならfalse (書き込み側のみ)
+    // Append a move; returns false when full (producer only)
+    bool push(CubeMove move) {
+        const uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) >= CAPACITY) return false;
+        buffer_[tail & (CAPACITY - 1)] = move;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 先頭を取り出す. 空ならfalse (読み出し側のみ)
+    // Pop the front move; returns false when empty (consumer only)
+    bool pop(CubeMove &move) {
+        const uint32_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) return false;
+        move = buffer_[head & (CAPACITY - 1)];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 溜まっている手を全て捨てる (読み出し側のみ)
+    // Drop every pending move (consumer only)
+    void clear() {
+        head_.store(tail_.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    int size() const {
+        return (int)(tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire));
+    }
+    bool empty() const { return size() == 0; }
+
+private:
+    CubeMove buffer_[CAPACITY];
+    std::atomic<uint32_t> head_{ 0 };  // 次に読む位置 / Next slot to read
+    std::atomic<uint32_t> tail_{ 0 };  // 次に書く位置 / Next slot to write
+};
+
+#endif  // _MOVE_QUEUE_H_
@@ -0,0 +1,92 @@
+// アセットパックを作る道具 / Tool that builds the asset pack
+//
+//   ./pack_assets [--keep-encoded] <出力 / output> <ディレクトリ / directory>...
+//
+// ディレクトリ以下のファイルを全て1つのパックにまとめる. 名前は現在のディレクトリからの相対パス.
+// 画像はRGBA8にデコードして入れるので, 起動時にデコードしなくてよい (--keep-encoded ならそのまま)
+// Packs every file under the given directories; entries are named by their path relative
+// to the current directory. Images are stored decoded to RGBA8 so startup does not have
+// to decode them (unless --keep-encoded is given).
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "asset_pack.h"
+
+static bool isImage(const std::filesystem::path &path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".bmp" ||
+           extension == ".tga";
+}
+
+int main(int argc, char **argv) {
+    bool keepEncoded = false;
+    std::vector<std::string> arguments;
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        if (argument == "--keep-encoded") {
+            keepEncoded = true;
+        } else {
+            arguments.push_back(argument);
+        }
+    }
+    if (arguments.size() < 2) {
+        fprintf(stderr, "Usage: %s [--keep-encoded] <output> <directory>...\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<std::filesystem::path> files;
+    for (size_t i = 1; i < arguments.size(); ++i) {
+        std::error_code ec;
+        for (auto it = std::filesystem::recursive_directory_iterator(arguments[i], ec);
+             !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+            if (it->is_regular_file() && it->path().filename().string()[0] != '.') files.push_back(it->path());
+        }
+        if (ec) {
+            fprintf(stderr, "Failed to read directory: %s\n", arguments[i].c_str());
+            return 1;
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    std::vector<AssetPack::Source> sources;
+    size_t total = 0;
+    for (const std::filesystem::path &file : files) {
+        std::ifstream reader(file, std::ios::binary);
+        AssetPack::Source source;
+        source.name = file.lexically_normal().generic_string();
+        source.data.assign(std::istreambuf_iterator<char>(reader), std::istreambuf_iterator<char>());
+        source.hash = fnv1a(source.data.data(), source.data.size());
+
+        if (!keepEncoded && isImage(file)) {
+            int width, height, channels;
+            unsigned char *pixels = stbi_load_from_memory(source.data.data(), (int)source.data.size(), &width, &height,
+                                                          &channels, STBI_rgb_alpha);
+            if (pixels) {
+                source.data.assign(pixels, pixels + (size_t)width * height * 4);
+                source.width = width;
+                source.height = height;
+                stbi_image_free(pixels);
+            } else {
+                fprintf(stderr, "Failed to decode %s; storing it as is\n", source.name.c_str());
+            }
+        }
+
+        printf("%-40s %10zu bytes%s\n", source.name.c_str(), source.data.size(), source.width > 0 ? " (decoded)" : "");
+        total += source.data.size();
+        sources.push_back(std::move(source));
+    }
+
+    if (!AssetPack::write(arguments[0], sources)) return 1;
+    printf("%zu files, %zu bytes -> %s\n", sources.size(), total, arguments[0].c_str());
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include "program_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "asset_pack.h"
+
+// ---------------------------------------------------------------------------
+// キャッシュファイル / Cache file
+// ---------------------------------------------------------------------------
+// [ヘッダ][プログラムのバイナリ] / [header][program binary]
+
+const char PROGRAM_CACHE_MAGIC[8] = { 'C', 'C', 'P', 'R', 'O', 'G', 'R', '1' };
+
+struct ProgramCacheHeader {
+    char magic[8];
+    uint64_t key;
+    uint32_t format;
+    uint32_t length;
+};
+
+// ドライバとソースから作るキー / Key built from the driver and the sources
+static uint64_t programKey(uint64_t sourceHash) {
+    uint64_t key = FNV_OFFSET_BASIS;
+    for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+        const char *value = (const char *)glGetString(name);
+        if (value) key = fnv1a(value, std::strlen(value), key);
+        key = fnv1a("|", 1, key);
+    }
+    return fnv1a(&sourceHash, sizeof(sourceHash), key);
+}
+
+ProgramCache::ProgramCache(std::string directory)
+    : directory_(std::move(directory)) {
+}
+
+GLuint ProgramCache::load(const std::string &name, uint64_t sourceHash, const Builder &build) const {
+    // バイナリの形式が1つも無いドライバでは使えない / Drivers without any binary format cannot cache
+    GLint numFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+    if (numFormats <= 0) return build();
+
+    const uint64_t key = programKey(sourceHash);
+    const std::string path = directory_ + name + ".bin";
+
+    size_t size = 0;
+    if (auto mapped = mapFile(path, size)) {
+        const unsigned char *base = (const unsigned char *)mapped.get();
+        ProgramCacheHeader header;
+        if (size >= sizeof(header)) {
+            std::memcpy(&header, base, sizeof(header));
+            if (std::memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic)) == 0 && header.key == key &&
+                sizeof(header) + header.length <= size) {
+                GLuint programId = glCreateProgram();
+                glProgramBinary(programId, header.format, base + sizeof(header), (GLsizei)header.length);
+                GLint linkState = GL_FALSE;
+                glGetProgramiv(programId, GL_LINK_STATUS, &linkState);
+                if (linkState == GL_TRUE) return programId;
+
+                // 受け付けられなかったので作り直す / Rejected by the driver; rebuild below
+                glDeleteProgram(programId);
+                while (glGetError() != GL_NO_ERROR) continue;  // 残ったエラーを消す / Clear the errors it left
+            }
+        }
+    }
+
+    const GLuint programId = build();
+
+    GLint length = 0;
+    glGetProgramiv(programId, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return programId;
+    std::vector<unsigned char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(programId, length, &length, &format, binary.data());
+
+    // 一時ファイルに書いてから置き換える / Write to a temporary file, then rename
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+    const std::string temp = path + ".tmp";
+    {
+        std::ofstream writer(temp, std::ios::binary);
+        if (!writer.is_open()) {
+            fprintf(stderr, "Failed to write program cache: %s\n", path.c_str());
+            return programId;
+        }
+        ProgramCacheHeader header = {};
+        std::memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic));
+        header.key = key;
+        header.format = format;
+        header.length = (uint32_t)length;
+        writer.write((const char *)&header, sizeof(header));
+        writer.write((const char *)binary.data(), length);
+        if (!writer) {
+            fprintf(stderr, "Failed to write program cache: %s\n", path.c_str());
+            writer.close();
+            std::filesystem::remove(temp, ec);
+            return programId;
+        }
+    }
+    std::filesystem::rename(temp, path, ec);
+    if (ec) std::filesystem::remove(temp, ec);
+    return programId;
+}
@@ -0,0 +1,33 @@
+#ifndef _PROGRAM_CACHE_H_
+#define _PROGRAM_CACHE_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include <glad/gl.h>
+
+// リンク済みシェーダプログラムのバイナリを保存しておくキャッシュ
+// GLのベンダ・レンダラ・バージョンの文字列とシェーダのソースのハッシュで引き, 一致すれば
+// コンパイルもリンクもせずにglProgramBinaryで読み込む. 形式が合わない (ドライバの更新など)
+// 時は普通にコンパイルし, 作り直したバイナリで上書きする
+// Cache of linked shader program binaries. Entries are keyed by the GL vendor, renderer
+// and version strings plus a hash of the shader sources; on a hit the program is loaded
+// with glProgramBinary and nothing is compiled or linked. If the driver rejects the
+// binary (e.g. after an update) the program is compiled normally and the entry rewritten.
+class ProgramCache {
+public:
+    // プログラムを普通に作る処理 (コンパイルとリンク) / Builds the program normally (compile and link)
+    using Builder = std::function<GLuint()>;
+
+    explicit ProgramCache(std::string directory);
+
+    // nameのプログラムを返す. sourceHashはシェーダのソース全体のハッシュ
+    // Return the program called name; sourceHash covers all of its shader sources
+    GLuint load(const std::string &name, uint64_t sourceHash, const Builder &build) const;
+
+private:
+    std::string directory_;
+};
+
+#endif  // _PROGRAM_CACHE_H_
@@ -0,0 +1,92 @@
+#include "readback.h"
+
+ReadbackService::~ReadbackService() {
+    // GLコンテキストが既に無いかもしれないのでここでは解放しない (release()を使う)
+    // The GL context may already be gone here, so GL objects are freed by release() instead
+    requests_.clear();
+    freeBuffers_.clear();
+}
+
+ReadbackService::PooledBuffer ReadbackService::acquireBuffer(GLsizeiptr size) {
+    // 十分な大きさの空きPBOがあれば使い回す / Reuse a free PBO that is large enough
+    for (size_t i = 0; i < freeBuffers_.size(); ++i) {
+        if (freeBuffers_[i].size >= size) {
+            PooledBuffer buffer = freeBuffers_[i];
+            freeBuffers_.erase(freeBuffers_.begin() + i);
+            return buffer;
+        }
+    }
+
+    PooledBuffer buffer;
+    if (!freeBuffers_.empty()) {
+        // 小さすぎる空きPBOは作り直す / Grow a free PBO that is too small
+        buffer = freeBuffers_.back();
+        freeBuffers_.pop_back();
+    } else {
+        glGenBuffers(1, &buffer.id);
+    }
+    buffer.size = size;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.id);
+    glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return buffer;
+}
+
+void ReadbackService::read(int x, int y, int width, int height, Callback callback) {
+    if (width <= 0 || height <= 0) return;
+
+    Request request;
+    request.buffer = acquireBuffer((GLsizeiptr)width * height * 4);
+    request.width = width;
+    request.height = height;
+    request.callback = std::move(callback);
+
+    // PBOが結びついている間, glReadPixelsはコピーを発行するだけですぐ戻る
+    // With a PBO bound, glReadPixels only schedules the copy and returns immediately
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, request.buffer.id);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void *)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    request.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    requests_.push_back(std::move(request));
+}
+
+void ReadbackService::poll() {
+    // 要求は発行順に終わるので, 先頭から終わったものだけ取り出す
+    // Reads complete in submission order, so drain finished ones from the front
+    while (!requests_.empty()) {
+        Request &request = requests_.front();
+        const GLenum status = glClientWaitSync(request.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+        glDeleteSync(request.fence);
+
+        const size_t size = (size_t)request.width * request.height * 4;
+        std::vector<unsigned char> pixels(size);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, request.buffer.id);
+        const void *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)size, GL_MAP_READ_BIT);
+        if (mapped != nullptr) {
+            const unsigned char *src = (const unsigned char *)mapped;
+            pixels.assign(src, src + size);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        freeBuffers_.push_back(request.buffer);
+        Callback callback = std::move(request.callback);
+        const int width = request.width, height = request.height;
+        requests_.pop_front();
+
+        if (mapped != nullptr && callback) callback(width, height, pixels);
+    }
+}
+
+void ReadbackService::release() {
+    for (Request &request : requests_) {
+        glDeleteSync(request.fence);
+        glDeleteBuffers(1, &request.buffer.id);
+    }
+    requests_.clear();
+    for (PooledBuffer &buffer : freeBuffers_) glDeleteBuffers(1, &buffer.id);
+    freeBuffers_.clear();
+}
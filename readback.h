@@ -0,0 +1,56 @@
+#ifndef _READBACK_H_
+#define _READBACK_H_
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include <glad/gl.h>
+
+// GPUからの画素の読み戻しを非同期に行うクラス
+// glReadPixelsをピクセルバッファオブジェクト (PBO) に向けて発行し, フェンスで完了を待つ.
+// 結果は1〜2フレーム後のpoll()でコールバックに渡されるので, 描画スレッドは止まらない
+// Asynchronous GPU-to-CPU pixel readback. glReadPixels is issued into a pixel buffer
+// object and completion is tracked with a fence; results reach the callback from poll()
+// one or two frames later, so the render thread never stalls.
+class ReadbackService {
+public:
+    // 読み戻した画素 (RGBA8, 下の行から) / Pixels read back (RGBA8, bottom row first)
+    using Callback = std::function<void(int width, int height, const std::vector<unsigned char> &rgba)>;
+
+    ~ReadbackService();
+
+    // 現在の読み取りフレームバッファの矩形を読む要求を積む (描画の後, swapの前に呼ぶ)
+    // Queue a read of a rectangle of the current read framebuffer (call after drawing, before the swap)
+    void read(int x, int y, int width, int height, Callback callback);
+
+    // 完了した読み戻しのコールバックを呼ぶ. 毎フレーム呼ぶ (待たない)
+    // Deliver finished reads to their callbacks; call once per frame (never blocks)
+    void poll();
+
+    // 未完了の要求を捨ててバッファを解放する (GLコンテキストがある間に呼ぶ)
+    // Drop pending reads and free the buffers (call while the GL context is alive)
+    void release();
+
+    int pending() const { return (int)requests_.size(); }
+
+private:
+    struct PooledBuffer {
+        GLuint id;
+        GLsizeiptr size;
+    };
+
+    struct Request {
+        PooledBuffer buffer;
+        GLsync fence;
+        int width, height;
+        Callback callback;
+    };
+
+    PooledBuffer acquireBuffer(GLsizeiptr size);
+
+    std::deque<Request> requests_;
+    std::vector<PooledBuffer> freeBuffers_;  // 使い回すPBO / PBOs ready for reuse
+};
+
+#endif  // _READBACK_H_
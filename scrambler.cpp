@@ -0,0 +1,206 @@
+#include "scrambler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <thread>
+
+#include "solver.h"
+
+// スクランブルは最短でなくてよいので, 早く見つかる長さで打ち切る
+// Scrambles need not be optimal, so stop at a length that is found quickly
+static const int SCRAMBLE_MAX_LENGTH = 22;
+
+// 0〜n-1の乱数. std::uniform_int_distributionは実装ごとに結果が違うので使わない
+// Random number in 0..n-1. std::uniform_int_distribution differs between
+// standard libraries, which would break reproducible seeds
+static int randomBelow(std::mt19937_64 &rng, int n) {
+    return (int)(rng() % (uint64_t)n);
+}
+
+template <int N>
+static int shuffleWithParity(std::mt19937_64 &rng, uint8_t (&p)[N]) {
+    int parity = 0;
+    for (int i = N - 1; i > 0; --i) {
+        const int j = randomBelow(rng, i + 1);
+        if (j != i) {
+            std::swap(p[i], p[j]);
+            parity ^= 1;
+        }
+    }
+    return parity;
+}
+
+CubeState randomCubeState(uint64_t seed, bool randomCenters) {
+    std::mt19937_64 rng(seed);
+    CubeState s = CubeState::solved();
+
+    // 角と辺の置換の偶奇は一致していなければならない
+    // Corner and edge permutations must have the same parity
+    const int cornerParity = shuffleWithParity(rng, s.cp);
+    const int edgeParity = shuffleWithParity(rng, s.ep);
+    if (cornerParity != edgeParity) std::swap(s.ep[10], s.ep[11]);
+
+    // 向きの和は角が3の倍数, 辺が偶数 / Twists sum to 0 mod 3, flips to 0 mod 2
+    int twist = 0, flip = 0;
+    for (int i = 0; i < 7; ++i) {
+        s.co[i] = (uint8_t)randomBelow(rng, 3);
+        twist += s.co[i];
+    }
+    s.co[7] = (uint8_t)((3 - twist % 3) % 3);
+    for (int i = 0; i < 11; ++i) {
+        s.eo[i] = (uint8_t)randomBelow(rng, 2);
+        flip += s.eo[i];
+    }
+    s.eo[11] = (uint8_t)(flip & 1);
+
+    // センターの向きの和の偶奇は角の置換の偶奇と一致する (面を1/4回すと両方が変わる)
+    // The parity of the centre twists matches the corner parity (a face quarter turn flips both)
+    if (randomCenters) {
+        int centerTwist = 0;
+        for (int i = 0; i < 5; ++i) {
+            s.xo[i] = (uint8_t)randomBelow(rng, 4);
+            centerTwist += s.xo[i];
+        }
+        s.xo[5] = (uint8_t)(randomBelow(rng, 2) * 2 + ((centerTwist + cornerParity) & 1));
+    }
+    return s;
+}
+
+bool randomScramble(uint64_t seed, bool randomCenters, std::vector<CubeMove> &moves,
+                    const std::atomic<bool> *cancel) {
+    const CubeState target = randomCubeState(seed, randomCenters);
+
+    // 目標の状態を解く手順の逆が, 揃った状態から目標を作る手順
+    // The inverse of a solution for the target builds the target from the solved cube
+    std::vector<CubeMove> solution;
+    moves.clear();
+    if (!solveCube(target, solution, randomCenters, SCRAMBLE_MAX_LENGTH, cancel)) return false;
+    for (auto it = solution.rbegin(); it != solution.rend(); ++it) moves.push_back(inverseMove(*it));
+    return true;
+}
+
+AsyncScrambler::~AsyncScrambler() {
+    shutdown();
+}
+
+void AsyncScrambler::start(uint64_t seed, bool randomCenters, const std::string &cacheFile) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // 最初のスクランブルでワーカーを起動する / The worker is started by the first scramble
+        if (!thread_.joinable()) {
+            stopping_ = false;
+            thread_ = std::thread(&AsyncScrambler::workerLoop, this);
+        }
+        request_ = { seed, randomCenters, cacheFile };
+        hasRequest_ = true;
+        ++generation_;
+        cancel_ = true;
+        seed_ = seed;
+        found_ = false;
+        moves_.clear();
+        status_ = SEARCHING;
+    }
+    wake_.notify_one();
+}
+
+void AsyncScrambler::workerLoop() {
+    for (;;) {
+        Request request;
+        int generation;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this]() { return stopping_ || hasRequest_; });
+            if (stopping_) return;
+            request = std::move(request_);
+            hasRequest_ = false;
+            generation = generation_;
+            cancel_ = false;
+        }
+
+        // 表の生成は終了時にだけやめる / Table generation stops only at shutdown
+        std::vector<CubeMove> moves;
+        const bool found = initSolverTables(request.cacheFile, &stopping_) &&
+                           randomScramble(request.seed, request.randomCenters, moves, &cancel_);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (generation != generation_ || stopping_) continue;
+        found_ = found;
+        moves_.swap(moves);
+        status_ = DONE;
+    }
+}
+
+void AsyncScrambler::cancel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    hasRequest_ = false;
+    ++generation_;
+    cancel_ = true;
+    status_ = IDLE;
+}
+
+bool AsyncScrambler::take(std::vector<CubeMove> &moves) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    status_ = IDLE;
+    moves.swap(moves_);
+    moves_.clear();
+    return found_;
+}
+
+void AsyncScrambler::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        cancel_ = true;
+        hasRequest_ = false;
+        ++generation_;
+        status_ = IDLE;
+    }
+    wake_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+void randomScrambles(uint64_t firstSeed, int count, bool randomCenters,
+                     std::vector<std::vector<CubeMove>> &scrambles, int numThreads) {
+    scrambles.assign(std::max(count, 0), {});
+    if (numThreads <= 0) numThreads = (int)std::max(1u, std::thread::hardware_concurrency());
+    numThreads = std::min(numThreads, std::max(count, 1));
+
+    // 各スレッドが次の番号を取り合う (結果はseedの順に並ぶ)
+    // Threads claim the next index in turn; results stay ordered by seed
+    std::atomic<int> next{ 0 };
+    auto worker = [&]() {
+        for (int i = next++; i < count; i = next++) {
+            randomScramble(firstSeed + (uint64_t)i, randomCenters, scrambles[i]);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < numThreads; ++t) threads.emplace_back(worker);
+    worker();
+    for (std::thread &t : threads) t.join();
+}
+
+std::string formatMoves(const std::vector<CubeMove> &moves) {
+    // 番号 (軸, 層, 向き) ごとの表記. 中層はM (Lと同じ向き), E (Dと同じ), S (Fと同じ)
+    // Notation per move code; slices follow M = L, E = D, S = F
+    static const char *NAMES[NUM_CUBE_MOVES] = {
+        "L", "L'", "M", "M'", "R'", "R",
+        "D", "D'", "E", "E'", "U'", "U",
+        "B", "B'", "S'", "S", "F'", "F"
+    };
+    std::string out;
+    for (size_t i = 0; i < moves.size(); ++i) {
+        if (!out.empty()) out += ' ';
+        // 同じ手が2回続いたら "X2" とまとめる / Fold a repeated move into "X2"
+        const bool twice = i + 1 < moves.size() && moves[i + 1] == moves[i];
+        const char *name = NAMES[moves[i]];
+        if (twice) {
+            out += name[0];
+            out += '2';
+            ++i;
+        } else {
+            out += name;
+        }
+    }
+    return out;
+}
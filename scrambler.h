@@ -0,0 +1,92 @@
+#ifndef _SCRAMBLER_H_
+#define _SCRAMBLER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cube_state.h"
+
+// 一様ランダムな状態によるスクランブル
+// 全ての合法な状態から等確率に1つ選び, ソルバーでその状態を作る手順を求める.
+// 同じseedからは常に同じスクランブルができる. ソルバーの表が用意されている必要がある
+// Random-state scrambles: pick a legal state uniformly at random and use the solver to
+// find a sequence that produces it. The same seed always gives the same scramble.
+// The solver tables must be ready (see initSolverTables).
+
+// seedから一様ランダムな合法状態を作る. randomCentersならセンターの向きも混ぜる (ArtMode用)
+// Uniformly random legal state for a seed; randomCenters also randomises centre orientations (ArtMode)
+CubeState randomCubeState(uint64_t seed, bool randomCenters);
+
+// 揃った状態からrandomCubeState(seed)を作る手順. cancelが立つとfalseで戻る
+// Moves turning the solved cube into randomCubeState(seed); returns false once cancel is set
+bool randomScramble(uint64_t seed, bool randomCenters, std::vector<CubeMove> &moves,
+                    const std::atomic<bool> *cancel = nullptr);
+
+// firstSeed, firstSeed + 1, ... のスクランブルをcount個, 全コアを使って作る
+// numThreadsが0なら論理コア数だけスレッドを使う
+// Generate count scrambles for firstSeed, firstSeed + 1, ... on all cores
+// (numThreads = 0 uses one thread per hardware thread)
+void randomScrambles(uint64_t firstSeed, int count, bool randomCenters,
+                     std::vector<std::vector<CubeMove>> &scrambles, int numThreads = 0);
+
+// 別スレッドでスクランブルを作る (表の読み込み・生成も含む). メインループは毎フレームstatus()を見て,
+// DONEになったらtake()で受け取る. AsyncSolverと同じく, ワーカーは1本を使い回して待たない
+// Builds a scramble on a worker thread, including loading or generating the solver tables.
+// The main loop polls status() each frame and collects the result with take() once it is DONE.
+// Like AsyncSolver, one worker is reused and no call waits for it (except shutdown()).
+class AsyncScrambler {
+public:
+    enum Status { IDLE, SEARCHING, DONE };
+
+    ~AsyncScrambler();
+
+    // seedのスクランブルを作り始める. 作りかけのものがあればキャンセルして置き換える
+    // Start building the scramble for seed; one still being built is cancelled and replaced
+    void start(uint64_t seed, bool randomCenters, const std::string &cacheFile);
+    // 作りかけのスクランブルを捨ててIDLEに戻る. 表の生成中なら生成は続ける
+    // Drop the scramble being built and go back to IDLE; table generation in progress carries on
+    void cancel();
+    // 探索も表の生成もやめてワーカーを終わらせる (終了時に呼ぶ)
+    // Abandon the search and any table generation and join the worker (call at exit)
+    void shutdown();
+
+    Status status() const { return status_; }
+    uint64_t seed() const { return seed_; }
+    // DONEの結果を受け取り, IDLEに戻す. 作れなかった時はfalse
+    // Take a DONE result and go back to IDLE; false if no scramble could be built
+    bool take(std::vector<CubeMove> &moves);
+
+private:
+    struct Request {
+        uint64_t seed = 0;
+        bool randomCenters = false;
+        std::string cacheFile;
+    };
+
+    void workerLoop();
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    Request request_;
+    bool hasRequest_ = false;
+    // start()とcancel()のたびに増える. 古いスクランブルを捨てるために使う
+    // Bumped by every start() and cancel(); older scrambles are dropped
+    int generation_ = 0;
+    std::atomic<bool> cancel_{ false };
+    std::atomic<bool> stopping_{ false };
+    std::atomic<Status> status_{ IDLE };
+    uint64_t seed_ = 0;
+    bool found_ = false;
+    std::vector<CubeMove> moves_;
+};
+
+// 手順を "R U' M2 ..." のような表記にする / Format moves in standard notation ("R U' M ...")
+std::string formatMoves(const std::vector<CubeMove> &moves);
+
+#endif  // _SCRAMBLER_H_
@@ -0,0 +1,163 @@
+#include "shader_program.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <glm/gtc/type_ptr.hpp>
+
+// 配列のuniform変数は "name[0]" という名前で報告されるので末尾を取り除く
+// Array uniforms are reported as "name[0]"; strip the suffix
+static std::string stripArraySuffix(const std::string &name) {
+    const size_t pos = name.find("[0]");
+    return pos == std::string::npos ? name : name.substr(0, pos);
+}
+
+ShaderProgram::ShaderProgram(GLuint programId)
+    : program_(programId) {
+    // アクティブなuniform変数の列挙
+    // Enumerate active uniforms
+    GLint numUniforms = 0, maxNameLength = 0;
+    glGetProgramiv(programId, GL_ACTIVE_UNIFORMS, &numUniforms);
+    glGetProgramiv(programId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+    std::string name(std::max(maxNameLength, 1), '\0');
+    for (GLint i = 0; i < numUniforms; ++i) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(programId, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, &name[0]);
+        const std::string uniformName(name.data(), length);
+
+        // uniformブロックのメンバは位置を持たないので飛ばす
+        // Uniform block members have no location
+        const GLint location = glGetUniformLocation(programId, uniformName.c_str());
+        if (location < 0) continue;
+
+        uniformSlots_[stripArraySuffix(uniformName)] = (int)slots_.size();
+        slots_.push_back({ location, type, size, {} });
+    }
+
+    // アクティブなattribute変数の列挙
+    // Enumerate active attributes
+    GLint numAttribs = 0;
+    glGetProgramiv(programId, GL_ACTIVE_ATTRIBUTES, &numAttribs);
+    glGetProgramiv(programId, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxNameLength);
+    name.assign(std::max(maxNameLength, 1), '\0');
+    for (GLint i = 0; i < numAttribs; ++i) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveAttrib(programId, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, &name[0]);
+        const std::string attribName(name.data(), length);
+        attribLocations_[attribName] = glGetAttribLocation(programId, attribName.c_str());
+    }
+
+    // uniformブロックの列挙
+    // Enumerate uniform blocks
+    GLint numBlocks = 0;
+    glGetProgramiv(programId, GL_ACTIVE_UNIFORM_BLOCKS, &numBlocks);
+    glGetProgramiv(programId, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxNameLength);
+    name.assign(std::max(maxNameLength, 1), '\0');
+    for (GLint i = 0; i < numBlocks; ++i) {
+        GLsizei length = 0;
+        glGetActiveUniformBlockName(programId, (GLuint)i, (GLsizei)name.size(), &length, &name[0]);
+        blockIndices_[std::string(name.data(), length)] = (GLuint)i;
+    }
+}
+
+ShaderProgram::Uniform ShaderProgram::uniform(const std::string &name) const {
+    auto it = uniformSlots_.find(name);
+    Uniform u;
+    if (it != uniformSlots_.end()) u.slot = it->second;
+    return u;
+}
+
+GLint ShaderProgram::uniformLocation(const std::string &name) const {
+    const Uniform u = uniform(name);
+    return u.valid() ? slots_[u.slot].location : -1;
+}
+
+GLint ShaderProgram::attribLocation(const std::string &name) const {
+    auto it = attribLocations_.find(name);
+    return it != attribLocations_.end() ? it->second : -1;
+}
+
+bool ShaderProgram::changed(Uniform u, const void *data, size_t size) {
+    std::vector<unsigned char> &cache = slots_[u.slot].value;
+    if (cache.size() == size && std::memcmp(cache.data(), data, size) == 0) {
+        return false;
+    }
+    cache.assign((const unsigned char *)data, (const unsigned char *)data + size);
+    return true;
+}
+
+void ShaderProgram::set(Uniform u, int value) {
+    if (!u.valid() || !changed(u, &value, sizeof(value))) return;
+    glUniform1i(slots_[u.slot].location, value);
+}
+
+void ShaderProgram::set(Uniform u, float value) {
+    if (!u.valid() || !changed(u, &value, sizeof(value))) return;
+    glUniform1f(slots_[u.slot].location, value);
+}
+
+void ShaderProgram::set(Uniform u, const glm::vec3 &value) {
+    if (!u.valid() || !changed(u, glm::value_ptr(value), sizeof(glm::vec3))) return;
+    glUniform3fv(slots_[u.slot].location, 1, glm::value_ptr(value));
+}
+
+void ShaderProgram::set(Uniform u, const glm::vec3 *values, int count) {
+    if (!u.valid()) return;
+    count = std::min(count, (int)slots_[u.slot].arraySize);
+    if (!changed(u, values, sizeof(glm::vec3) * count)) return;
+    glUniform3fv(slots_[u.slot].location, count, glm::value_ptr(values[0]));
+}
+
+void ShaderProgram::set(Uniform u, const glm::ivec4 *values, int count) {
+    if (!u.valid()) return;
+    count = std::min(count, (int)slots_[u.slot].arraySize);
+    if (!changed(u, values, sizeof(glm::ivec4) * count)) return;
+    glUniform4iv(slots_[u.slot].location, count, glm::value_ptr(values[0]));
+}
+
+void ShaderProgram::set(Uniform u, const glm::mat3 *values, int count) {
+    if (!u.valid()) return;
+    count = std::min(count, (int)slots_[u.slot].arraySize);
+    if (!changed(u, values, sizeof(glm::mat3) * count)) return;
+    glUniformMatrix3fv(slots_[u.slot].location, count, GL_FALSE, glm::value_ptr(values[0]));
+}
+
+void ShaderProgram::set(Uniform u, const glm::mat4 &value) {
+    if (!u.valid() || !changed(u, glm::value_ptr(value), sizeof(glm::mat4))) return;
+    glUniformMatrix4fv(slots_[u.slot].location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+bool ShaderProgram::bindUniformBlock(const std::string &blockName, GLuint bindingPoint) const {
+    auto it = blockIndices_.find(blockName);
+    if (it == blockIndices_.end()) return false;
+    glUniformBlockBinding(program_, it->second, bindingPoint);
+    return true;
+}
+
+void UniformBuffer::init(GLsizeiptr size, GLuint bindingPoint) {
+    buffer_ = GLBuffer::create();
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+    glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, buffer_);
+    shadow_.clear();
+}
+
+void UniformBuffer::release() {
+    buffer_.reset();
+    shadow_.clear();
+}
+
+void UniformBuffer::update(const void *data, GLsizeiptr size) {
+    if ((GLsizeiptr)shadow_.size() == size && std::memcmp(shadow_.data(), data, size) == 0) {
+        return;
+    }
+    shadow_.assign((const unsigned char *)data, (const unsigned char *)data + size);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,91 @@
+#ifndef _SHADER_PROGRAM_H_
+#define _SHADER_PROGRAM_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <glad/gl.h>
+
+#include "gl_resource.h"
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+// リンク済みのシェーダプログラムを包むクラス
+// リンク時に全てのアクティブなuniform変数とattribute変数を一度だけ調べておき,
+// 値が変わっていないuniform変数の再転送を省略する
+// Wrapper around a linked shader program. All active uniforms and attributes are
+// reflected once at link time, and setters skip uploads of unchanged values.
+// プログラムはこのクラスが所有し, 破棄時に削除する (ムーブのみ可能)
+// The program is owned and deleted with the wrapper (move-only).
+class ShaderProgram {
+public:
+    // uniform変数を参照するハンドル (名前検索は取得時の1回だけ)
+    // Handle to a reflected uniform (the name is looked up only once)
+    struct Uniform {
+        int slot = -1;
+        bool valid() const { return slot >= 0; }
+    };
+
+    ShaderProgram() = default;
+    explicit ShaderProgram(GLuint programId);
+
+    GLuint id() const { return program_; }
+    void use() const { glUseProgram(program_); }
+
+    // 名前からハンドル / 位置を得る. 存在しない (最適化で消えた) 場合は無効値
+    // Look up by name; returns an invalid handle / -1 if the variable is not active
+    Uniform uniform(const std::string &name) const;
+    GLint uniformLocation(const std::string &name) const;
+    GLint attribLocation(const std::string &name) const;
+
+    // 型付きのsetter. プログラムが有効化 (use) されている必要がある
+    // Typed setters; the program must be in use
+    void set(Uniform u, int value);
+    void set(Uniform u, float value);
+    void set(Uniform u, const glm::vec3 &value);
+    void set(Uniform u, const glm::vec3 *values, int count);
+    void set(Uniform u, const glm::mat4 &value);
+    void set(Uniform u, const glm::ivec4 *values, int count);
+    void set(Uniform u, const glm::mat3 *values, int count);
+
+    // uniformブロックをバインディングポイントに結びつける. ブロックが無ければfalse
+    // Attach a uniform block to a binding point; returns false if the block is not active
+    bool bindUniformBlock(const std::string &blockName, GLuint bindingPoint) const;
+
+private:
+    struct UniformSlot {
+        GLint location;
+        GLenum type;
+        GLint arraySize;
+        std::vector<unsigned char> value;  // 最後に転送した値 / Last uploaded value
+    };
+
+    // 前回と同じ値ならfalse, 違えば値を記録してtrue
+    // Returns false if the value is unchanged, otherwise records it and returns true
+    bool changed(Uniform u, const void *data, size_t size);
+
+    GLProgram program_;
+    std::vector<UniformSlot> slots_;
+    std::unordered_map<std::string, int> uniformSlots_;
+    std::unordered_map<std::string, GLint> attribLocations_;
+    std::unordered_map<std::string, GLuint> blockIndices_;
+};
+
+// uniformブロック用のバッファ (フレームごとの行列などを1回で転送する)
+// Buffer backing a uniform block (e.g. the per-frame matrices, uploaded in one go)
+class UniformBuffer {
+public:
+    void init(GLsizeiptr size, GLuint bindingPoint);
+    // バッファを削除する (GLコンテキストがある間に呼ぶ) / Free the buffer (call while the GL context is alive)
+    void release();
+    // 内容が変わった時だけ転送する / Uploads only when the contents changed
+    void update(const void *data, GLsizeiptr size);
+
+private:
+    GLBuffer buffer_;
+    std::vector<unsigned char> shadow_;
+};
+
+#endif  // _SHADER_PROGRAM_H_
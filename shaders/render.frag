@@ -1,14 +1,17 @@
 #version 330
 
 // Varying変数
-uniform int u_selectID;
 uniform int object; 
 uniform vec3 u_color;
 uniform int u_mode;         // ← 追加: 0=通常, 1=ArtMode
 uniform sampler2D u_sampler;
+uniform sampler2DArray u_faceSampler; // ArtMode: 6面の画像 (レイヤー=面番号)
 
 in vec3 f_fragColor;
 in vec2 f_texcoord; // 頂点シェーダから受け取る
+flat in int f_textured;
+flat in int f_layer;
+in vec4 f_tint;
 
 // ディスプレイへの出力変数
 out vec4 out_color;
@@ -16,18 +19,16 @@ out vec4 out_color;
 
 void main() {
     if (u_mode == 2) {
-        out_color = texture(u_sampler, f_texcoord);
-    } else if (u_selectID > 0) {
-        out_color = vec4(float(u_selectID) / 255.0, 0.0, 0.0, 1.0);
+        out_color = texture(u_sampler, f_texcoord) * f_tint;
     } else if (object == 0) {
         out_color = vec4(u_color, 1.0);      // 軸や円柱
-    } else if (u_mode == 1 && length(f_texcoord) > 0.0) {
-        // ArtMode: use glGenTextures
-        out_color = texture(u_sampler, f_texcoord);
-    } else if (u_mode == 0 && length(f_texcoord) > 0.0) {
-        // NonalMode: use glGenTextures
+    } else if (u_mode == 1 && f_textured != 0) {
+        // ArtMode: 面番号のレイヤーから画像を読む
+        out_color = texture(u_faceSampler, vec3(f_texcoord, float(f_layer)));
+    } else if (f_textured != 0) {
+        // 通常モードのアイコン
         out_color = texture(u_sampler, f_texcoord);
     } else {
         out_color = vec4(f_fragColor, 1.0);  // キューブ
     }
-}
\ No newline at end of file
+}
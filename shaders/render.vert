@@ -2,31 +2,114 @@
 
 // Attribute変数
 layout(location = 0) in vec3 in_position;
-layout(location = 1) in vec3 in_color;
+layout(location = 1) in int in_face;        // 面番号 = 色パレットの番号 (0:+X, 1:+Y, 2:+Z, 3:-Z, 4:-Y, 5:-X)
 layout(location = 2) in vec2 in_texcoord;
 
+
+// 2D描画 (スプライト) の色
+layout(location = 8) in vec4 in_tint;
+
 // Varying変数
 out vec3 f_fragColor;
 out vec2 f_texcoord; 
+flat out int f_textured;                    // テクスチャを貼るかどうか
+flat out int f_layer;                       // ArtModeで使う配列テクスチャのレイヤー (=面番号)
+out vec4 f_tint;                            // 2D描画で画像に掛ける色
 
 // Uniform変数
 uniform mat4 u_mvpMat;
 uniform int u_mode; // 0:通常, 1:ArtMode, 2:2D画像描画
+uniform int object; // 0:軸, 1:小立方体
+uniform vec3 u_faceColors[6];
+uniform mat3 u_rotations[24];               // 24通りの向きの回転行列
+uniform ivec4 u_cubies[27];                 // 小立方体ごとの配置 (xyz=論理位置, w=向きの番号). 手を回し終えた時だけ更新される
+uniform int u_readyFaces;                   // 画像の転送が終わった面 (ビットi = 面i). まだの面は単色で描く
+uniform int u_iconReady;                    // アイコン画像の転送が終わったか
+
+// フレームごとに1回だけ転送する行列
+layout(std140) uniform FrameMatrices {
+    mat4 u_projMat;
+    mat4 u_viewMat;
+    mat4 u_worldMat;    // アークボール操作による全体の変換
+    ivec4 u_turnLayer;  // 回している層 (x=軸, y=層番号). 回していなければx=-1
+    vec4 u_turnAngle;   // x=回している層の回転角 (ラジアン)
+};
+
+// 小立方体の間隔と, 1辺2のメッシュを小立方体の大きさにする倍率
+const float CUBIE_SPACING = 1.1;
+const float CUBIE_SCALE = 0.5;
+
+// 座標軸まわりの回転行列
+mat3 axisRotation(int axis, float angle) {
+    float c = cos(angle);
+    float s = sin(angle);
+    if (axis == 0) return mat3(1.0, 0.0, 0.0, 0.0, c, s, 0.0, -s, c);
+    if (axis == 1) return mat3(c, 0.0, -s, 0.0, 1.0, 0.0, s, 0.0, c);
+    return mat3(c, s, 0.0, -s, c, 0.0, 0.0, 0.0, 1.0);
+}
+
+// 初期位置で外側を向いている面か
+bool isOuterFace(int face, ivec3 home) {
+    if (face == 0) return home.x == 2;  // +X
+    if (face == 1) return home.y == 2;  // +Y
+    if (face == 2) return home.z == 2;  // +Z
+    if (face == 3) return home.z == 0;  // -Z
+    if (face == 4) return home.y == 0;  // -Y
+    return home.x == 0;                 // -X
+}
+
+// ArtModeで面の画像のどの1/3区画を使うか
+ivec2 stickerCell(int face, ivec3 home) {
+    if (face == 0) return ivec2(2 - home.z, 2 - home.y);  // +X
+    if (face == 1) return ivec2(home.x, home.z);          // +Y
+    if (face == 2) return ivec2(home.x, 2 - home.y);      // +Z
+    if (face == 3) return ivec2(2 - home.x, 2 - home.y);  // -Z
+    if (face == 4) return ivec2(home.x, 2 - home.z);      // -Y
+    return ivec2(home.z, 2 - home.y);                     // -X
+}
 
 void main() {
+    f_layer = 0;
+    f_tint = vec4(1.0);
     if (u_mode == 2) {
         // 2D画像描画用: in_positionのx,yのみ使う
         gl_Position = u_mvpMat * vec4(in_position.xy, 0.0, 1.0);
         f_fragColor = vec3(1.0);
         f_texcoord = in_texcoord;
-    } else {
-        // gl_Positionは頂点シェーダの組み込み変数
-        // 指定を忘れるとエラーになるので注意
+        f_textured = 1;
+        f_tint = in_tint;
+    } else if (object == 0) {
+        // 軸の円柱
         gl_Position = u_mvpMat * vec4(in_position, 1.0);
+        f_fragColor = vec3(1.0);
+        f_texcoord = vec2(0.0);
+        f_textured = 0;
+    } else {
+        // 小立方体: 向きと位置で置き, 回している層に入っていればその角度だけ回してから全体の変換を掛ける
+        // 頂点は小立方体ごとに24個ずつ並んでいるので, 番号から小立方体 (初期位置x*9+y*3+z) が分かる
+        int cubie = gl_VertexID / 24;
+        ivec3 home = ivec3(cubie / 9, (cubie / 3) % 3, cubie % 3);
+        ivec4 placement = u_cubies[cubie];
+        vec3 p = u_rotations[placement.w] * (in_position * CUBIE_SCALE) + vec3(placement.xyz - 1) * CUBIE_SPACING;
+        int turnAxis = u_turnLayer.x;
+        if (turnAxis >= 0 && placement[turnAxis] == u_turnLayer.y) {
+            p = axisRotation(turnAxis, u_turnAngle.x) * p;
+        }
+        gl_Position = u_projMat * u_viewMat * u_worldMat * vec4(p, 1.0);
 
-        // Varying変数への代入
-        f_fragColor = in_color;
+        bool outer = isOuterFace(in_face, home);
+        f_fragColor = outer ? u_faceColors[in_face] : vec3(0.0);
+        f_texcoord = in_texcoord;
+        f_textured = 0;
 
-        f_texcoord = in_texcoord;               // 追加
+        if (u_mode == 1 && outer && (u_readyFaces & (1 << in_face)) != 0) {
+            // ArtMode: 面の画像を3x3に分割して貼る
+            f_texcoord = (vec2(stickerCell(in_face, home)) + in_texcoord) / 3.0;
+            f_textured = 1;
+            f_layer = in_face;
+        } else if (u_mode == 0 && u_iconReady != 0 && in_face == 4 && home == ivec3(1, 0, 1)) {
+            // 通常モード: 白面の中心にアイコンを貼る
+            f_textured = 1;
+        }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,736 @@
+#include "solver.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
+using namespace cube_detail;
+
+namespace {
+
+// 面の順序は U, R, F, D, L, B. 面回転の番号は 面 * 3 + (回数 - 1)
+// Faces are ordered U, R, F, D, L, B; face move index = face * 3 + (power - 1)
+const int NUM_FACE_MOVES = 18;
+
+// 各面を外から見て時計回りに1/4回転する手 (アプリの手の番号)
+// Clockwise quarter turn of each face as seen from outside, in the app's move encoding
+const CubeMove FACE_QUARTER[6] = {
+    makeMove(1, 2, false),  // U (+y)
+    makeMove(0, 2, false),  // R (+x)
+    makeMove(2, 2, false),  // F (+z)
+    makeMove(1, 0, true),   // D (-y)
+    makeMove(0, 0, true),   // L (-x)
+    makeMove(2, 0, true)    // B (-z)
+};
+
+// フェーズ2で使える手: U, U2, U', D, D2, D', R2, F2, L2, B2
+// Moves allowed in phase 2
+const int PHASE2_MOVES[10] = { 0, 1, 2, 9, 10, 11, 4, 7, 13, 16 };
+const int ALL_MOVES[NUM_FACE_MOVES] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17 };
+
+bool isPhase2Move(int fm) {
+    const int face = fm / 3;
+    return face == 0 || face == 3 || fm % 3 == 1;
+}
+
+// 座標の大きさ / Coordinate sizes
+const int N_TWIST = 2187;       // 3^7: 角の向き / corner orientation
+const int N_FLIP = 2048;        // 2^11: 辺の向き / edge orientation
+const int N_SLICE = 495;        // 12C4: E層の辺の位置 / positions of the E-slice edges
+const int N_CORNER = 40320;     // 8!: 角の置換 / corner permutation
+const int N_EDGE8 = 40320;      // 8!: U/D層の辺の置換 / U/D edge permutation (phase 2)
+const int N_SLICE_PERM = 24;    // 4!: E層の辺の置換 / E-slice edge permutation (phase 2)
+const int SLICE_SOLVED = 494;   // 揃った状態のE層座標 / Slice coordinate of the solved state
+const int N_CENTER_PARITY = 16; // 2^4: 側面センターの向きの偶奇 / parity of the side-centre twists
+const int N_CENTER2 = 256;      // 4*4*2^4: フェーズ2のセンターの向き / centre twists in phase 2
+
+// 探索する手数の上限 (フェーズ2は長くしても得をしないので打ち切る.
+// センターの向きも揃える時はU/Dのセンターを回す分として1手だけ長く許す)
+// Search limits (long phase 2 searches rarely pay off; when centres are fixed too,
+// phase 2 gets one extra move for turning the U/D centres)
+const int MAX_SOLUTION_LENGTH = 30;
+const int MAX_PHASE2_LENGTH = 12;
+const int MAX_PHASE2_LENGTH_CENTERS = 13;
+// センターの向きも揃える解は5手ほど長い. その分だけ上限を緩めて始めないと,
+// 解の無い短い上限を調べ尽くすのに何秒もかかる
+// Solutions that also restore the centres run about five face turns longer. Starting
+// with the bound relaxed by that much avoids exhausting short bounds that have no solution,
+// which can take seconds.
+const int CENTER_EXTRA_LENGTH = 5;
+
+struct Tables {
+    std::vector<uint16_t> twistMove, flipMove, sliceMove;
+    std::vector<uint16_t> cornerMove, edge8Move, slicePermMove;
+    std::vector<uint16_t> centerParityMove, center2Move;
+    std::vector<uint8_t> twistSlicePrun, flipSlicePrun, twistCenterPrun;
+    std::vector<uint8_t> cornerSlicePrun, edge8SlicePrun, cornerCenterPrun;
+    std::atomic<bool> ready{ false };
+};
+Tables tables;
+
+// ---------------------------------------------------------------------------
+// 座標の計算 / Coordinates
+// ---------------------------------------------------------------------------
+
+int binom(int n, int k) {
+    if (k < 0 || k > n) return 0;
+    int r = 1;
+    for (int i = 0; i < k; ++i) r = r * (n - i) / (i + 1);
+    return r;
+}
+
+template <int N>
+int permRank(const uint8_t *p) {
+    int r = 0;
+    for (int i = 0; i < N; ++i) {
+        int smaller = 0;
+        for (int j = i + 1; j < N; ++j) {
+            if (p[j] < p[i]) ++smaller;
+        }
+        r = r * (N - i) + smaller;
+    }
+    return r;
+}
+
+template <int N>
+void permUnrank(int r, uint8_t *p) {
+    int digits[N];
+    for (int i = N - 1; i >= 0; --i) {
+        digits[i] = r % (N - i);
+        r /= (N - i);
+    }
+    bool used[N] = {};
+    for (int i = 0; i < N; ++i) {
+        int d = digits[i];
+        for (int v = 0; v < N; ++v) {
+            if (used[v]) continue;
+            if (d-- == 0) {
+                p[i] = (uint8_t)v;
+                used[v] = true;
+                break;
+            }
+        }
+    }
+}
+
+int getTwist(const CubeState &s) {
+    int t = 0;
+    for (int i = 0; i < 7; ++i) t = t * 3 + s.co[i];
+    return t;
+}
+
+void setTwist(CubeState &s, int t) {
+    int sum = 0;
+    for (int i = 6; i >= 0; --i) {
+        s.co[i] = (uint8_t)(t % 3);
+        sum += s.co[i];
+        t /= 3;
+    }
+    s.co[7] = (uint8_t)((3 - sum % 3) % 3);
+}
+
+int getFlip(const CubeState &s) {
+    int f = 0;
+    for (int i = 0; i < 11; ++i) f = f * 2 + s.eo[i];
+    return f;
+}
+
+void setFlip(CubeState &s, int f) {
+    int sum = 0;
+    for (int i = 10; i >= 0; --i) {
+        s.eo[i] = (uint8_t)(f & 1);
+        sum += s.eo[i];
+        f >>= 1;
+    }
+    s.eo[11] = (uint8_t)(sum & 1);
+}
+
+// E層の辺 (8〜11番) が入っているスロットの組合せ
+// Combination of slots holding the E-slice edges (cubies 8-11)
+int getSlice(const CubeState &s) {
+    int c = 0, k = 0;
+    for (int j = 0; j < 12; ++j) {
+        if (s.ep[j] >= 8) c += binom(j, ++k);
+    }
+    return c;
+}
+
+void setSlice(CubeState &s, int c) {
+    bool occupied[12] = {};
+    for (int k = 4; k >= 1; --k) {
+        int j = k - 1;
+        while (binom(j + 1, k) <= c) ++j;
+        occupied[j] = true;
+        c -= binom(j, k);
+    }
+    int sliceEdge = 8, otherEdge = 0;
+    for (int j = 0; j < 12; ++j) {
+        s.ep[j] = (uint8_t)(occupied[j] ? sliceEdge++ : otherEdge++);
+    }
+}
+
+int getCorner(const CubeState &s) { return permRank<8>(s.cp); }
+void setCorner(CubeState &s, int c) { permUnrank<8>(c, s.cp); }
+
+int getEdge8(const CubeState &s) { return permRank<8>(s.ep); }
+void setEdge8(CubeState &s, int c) { permUnrank<8>(c, s.ep); }
+
+int getSlicePerm(const CubeState &s) {
+    uint8_t p[4];
+    for (int i = 0; i < 4; ++i) p[i] = (uint8_t)(s.ep[8 + i] - 8);
+    return permRank<4>(p);
+}
+
+void setSlicePerm(CubeState &s, int c) {
+    uint8_t p[4];
+    permUnrank<4>(c, p);
+    for (int i = 0; i < 4; ++i) s.ep[8 + i] = (uint8_t)(p[i] + 8);
+}
+
+// センターの向き (ArtMode). フェーズ1では側面 (R, F, L, B) の向きを偶数にし,
+// フェーズ2ではU/Dの向き (0〜3) と側面の半回転の有無を扱う.
+// 側面は半回転しか使わないフェーズ2の手では偶奇が変わらないため
+// Centre twists (ArtMode). Phase 1 makes the side-centre (R, F, L, B) twists even;
+// phase 2 tracks the U/D twists (0-3) and whether each side centre is half turned,
+// since phase 2 only half turns the sides and cannot change their parity.
+const int SIDE_CENTERS[4] = { 1, 2, 4, 5 };
+
+int getCenterParity(const CubeState &s) {
+    int c = 0;
+    for (int i = 0; i < 4; ++i) c |= (s.xo[SIDE_CENTERS[i]] & 1) << i;
+    return c;
+}
+
+void setCenterParity(CubeState &s, int c) {
+    for (int i = 0; i < 4; ++i) s.xo[SIDE_CENTERS[i]] = (uint8_t)((c >> i) & 1);
+}
+
+int getCenter2(const CubeState &s) {
+    int c = s.xo[0] + s.xo[3] * 4;
+    for (int i = 0; i < 4; ++i) c |= (s.xo[SIDE_CENTERS[i]] >> 1) << (4 + i);
+    return c;
+}
+
+void setCenter2(CubeState &s, int c) {
+    s.xo[0] = (uint8_t)(c & 3);
+    s.xo[3] = (uint8_t)((c >> 2) & 3);
+    for (int i = 0; i < 4; ++i) s.xo[SIDE_CENTERS[i]] = (uint8_t)(((c >> (4 + i)) & 1) * 2);
+}
+
+// ---------------------------------------------------------------------------
+// 表の生成 / Table generation
+// ---------------------------------------------------------------------------
+
+template <typename Get, typename Set>
+void genMoveTable(std::vector<uint16_t> &table, int size, Get get, Set set, bool phase2Only) {
+    table.assign((size_t)size * NUM_FACE_MOVES, 0);
+    for (int c = 0; c < size; ++c) {
+        CubeState s = CubeState::solved();
+        set(s, c);
+        for (int f = 0; f < 6; ++f) {
+            CubeState t = s;
+            for (int p = 0; p < 3; ++p) {
+                t.apply(FACE_QUARTER[f]);
+                const int fm = f * 3 + p;
+                if (phase2Only && !isPhase2Move(fm)) continue;
+                table[(size_t)c * NUM_FACE_MOVES + fm] = (uint16_t)get(t);
+            }
+        }
+    }
+}
+
+bool cancelled(const std::atomic<bool> *cancel) {
+    return cancel != nullptr && cancel->load(std::memory_order_relaxed);
+}
+
+// 2つの座標の組に対する揃うまでの最短手数 (幅優先探索). キャンセルされたらfalse
+// Distance to the goal for every pair of two coordinates (breadth-first search); false if cancelled
+bool genPruningTable(std::vector<uint8_t> &prun, int n1, int n2,
+                     const std::vector<uint16_t> &move1, const std::vector<uint16_t> &move2,
+                     int goal1, int goal2, const int *moves, int numMoves, const std::atomic<bool> *cancel) {
+    const int size = n1 * n2;
+    prun.assign(size, 0xFF);
+    prun[goal1 * n2 + goal2] = 0;
+    for (int depth = 0;; ++depth) {
+        if (cancelled(cancel)) return false;
+        int filled = 0;
+        for (int i = 0; i < size; ++i) {
+            if (prun[i] != depth) continue;
+            const int c1 = i / n2, c2 = i % n2;
+            for (int k = 0; k < numMoves; ++k) {
+                const int fm = moves[k];
+                const int j = move1[(size_t)c1 * NUM_FACE_MOVES + fm] * n2 + move2[(size_t)c2 * NUM_FACE_MOVES + fm];
+                if (prun[j] == 0xFF) {
+                    prun[j] = (uint8_t)(depth + 1);
+                    ++filled;
+                }
+            }
+        }
+        if (filled == 0) break;
+    }
+    return true;
+}
+
+// 表を全て作る. 手の表はどれも一瞬で済むので, キャンセルは表の間と枝刈り表の深さごとに見る
+// Generate every table. Each move table takes only moments, so cancellation is checked
+// between tables and at every depth of the pruning-table searches. Returns false if cancelled.
+bool generateTables(const std::atomic<bool> *cancel) {
+    genMoveTable(tables.twistMove, N_TWIST, getTwist, setTwist, false);
+    genMoveTable(tables.flipMove, N_FLIP, getFlip, setFlip, false);
+    genMoveTable(tables.sliceMove, N_SLICE, getSlice, setSlice, false);
+    if (cancelled(cancel)) return false;
+    genMoveTable(tables.cornerMove, N_CORNER, getCorner, setCorner, true);
+    if (cancelled(cancel)) return false;
+    genMoveTable(tables.edge8Move, N_EDGE8, getEdge8, setEdge8, true);
+    genMoveTable(tables.slicePermMove, N_SLICE_PERM, getSlicePerm, setSlicePerm, true);
+    genMoveTable(tables.centerParityMove, N_CENTER_PARITY, getCenterParity, setCenterParity, false);
+    genMoveTable(tables.center2Move, N_CENTER2, getCenter2, setCenter2, true);
+
+    return genPruningTable(tables.twistSlicePrun, N_TWIST, N_SLICE, tables.twistMove, tables.sliceMove,
+                           0, SLICE_SOLVED, ALL_MOVES, NUM_FACE_MOVES, cancel) &&
+           genPruningTable(tables.flipSlicePrun, N_FLIP, N_SLICE, tables.flipMove, tables.sliceMove,
+                           0, SLICE_SOLVED, ALL_MOVES, NUM_FACE_MOVES, cancel) &&
+           genPruningTable(tables.twistCenterPrun, N_TWIST, N_CENTER_PARITY, tables.twistMove, tables.centerParityMove,
+                           0, 0, ALL_MOVES, NUM_FACE_MOVES, cancel) &&
+           genPruningTable(tables.cornerSlicePrun, N_CORNER, N_SLICE_PERM, tables.cornerMove, tables.slicePermMove,
+                           0, 0, PHASE2_MOVES, 10, cancel) &&
+           genPruningTable(tables.edge8SlicePrun, N_EDGE8, N_SLICE_PERM, tables.edge8Move, tables.slicePermMove,
+                           0, 0, PHASE2_MOVES, 10, cancel) &&
+           genPruningTable(tables.cornerCenterPrun, N_CORNER, N_CENTER2, tables.cornerMove, tables.center2Move,
+                           0, 0, PHASE2_MOVES, 10, cancel);
+}
+
+// ---------------------------------------------------------------------------
+// キャッシュファイル / Cache file
+// ---------------------------------------------------------------------------
+
+const char CACHE_MAGIC[8] = { 'C', 'C', 'S', 'O', 'L', 'V', 'E', '2' };
+
+// 全ての表を決まった順に並べたもの / All tables in a fixed order
+template <typename F>
+void forEachTable(F f) {
+    f(tables.twistMove, (size_t)N_TWIST * NUM_FACE_MOVES);
+    f(tables.flipMove, (size_t)N_FLIP * NUM_FACE_MOVES);
+    f(tables.sliceMove, (size_t)N_SLICE * NUM_FACE_MOVES);
+    f(tables.cornerMove, (size_t)N_CORNER * NUM_FACE_MOVES);
+    f(tables.edge8Move, (size_t)N_EDGE8 * NUM_FACE_MOVES);
+    f(tables.slicePermMove, (size_t)N_SLICE_PERM * NUM_FACE_MOVES);
+    f(tables.centerParityMove, (size_t)N_CENTER_PARITY * NUM_FACE_MOVES);
+    f(tables.center2Move, (size_t)N_CENTER2 * NUM_FACE_MOVES);
+    f(tables.twistSlicePrun, (size_t)N_TWIST * N_SLICE);
+    f(tables.flipSlicePrun, (size_t)N_FLIP * N_SLICE);
+    f(tables.twistCenterPrun, (size_t)N_TWIST * N_CENTER_PARITY);
+    f(tables.cornerSlicePrun, (size_t)N_CORNER * N_SLICE_PERM);
+    f(tables.edge8SlicePrun, (size_t)N_EDGE8 * N_SLICE_PERM);
+    f(tables.cornerCenterPrun, (size_t)N_CORNER * N_CENTER2);
+}
+
+bool loadTables(const std::string &cacheFile) {
+    std::ifstream reader(cacheFile, std::ios::binary);
+    if (!reader.is_open()) return false;
+
+    char magic[sizeof(CACHE_MAGIC)];
+    reader.read(magic, sizeof(magic));
+    if (!reader || std::memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0) return false;
+
+    bool ok = true;
+    forEachTable([&](auto &table, size_t count) {
+        if (!ok) return;
+        table.resize(count);
+        const std::streamsize bytes = (std::streamsize)(count * sizeof(table[0]));
+        reader.read((char *)table.data(), bytes);
+        ok = reader.gcount() == bytes;
+    });
+    return ok;
+}
+
+void saveTables(const std::string &cacheFile) {
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(cacheFile).parent_path(), ec);
+
+    std::ofstream writer(cacheFile, std::ios::binary);
+    if (!writer.is_open()) {
+        fprintf(stderr, "Failed to write solver tables: %s\n", cacheFile.c_str());
+        return;
+    }
+    writer.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    forEachTable([&](auto &table, size_t) {
+        writer.write((const char *)table.data(), (std::streamsize)(table.size() * sizeof(table[0])));
+    });
+}
+
+// ---------------------------------------------------------------------------
+// 探索 / Search
+// ---------------------------------------------------------------------------
+
+struct Search {
+    CubeState start;    // センターを揃えた初期状態 / Start state with centres in place
+    int moves[MAX_SOLUTION_LENGTH + 1];
+    int maxLength = 0;
+    int length = -1;    // 見つかった解の手数 / Length of the solution found
+
+    // センターの向きも揃える (ArtMode) / Also restore the centre orientations (ArtMode)
+    bool fixCenters = false;
+
+    // 解が見つかっても, より短い解を探し続ける (見つかるたびにonSolutionを呼ぶ)
+    // Keep looking for shorter solutions after the first one (onSolution is called for each)
+    bool keepImproving = false;
+    std::function<void(const int *moves, int length)> onSolution;
+
+    // 中断 (キャンセルか時間切れ) / Abort on cancellation or timeout
+    const std::atomic<bool> *cancel = nullptr;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    unsigned nodes = 0;
+    bool aborted = false;
+
+    bool stopped() {
+        // 時計を読むのは1024ノードに1回だけ / Only read the clock every 1024 nodes
+        if (!aborted && (++nodes & 1023) == 0) {
+            aborted = (cancel != nullptr && cancel->load(std::memory_order_relaxed)) ||
+                      std::chrono::steady_clock::now() > deadline;
+        }
+        return aborted;
+    }
+};
+
+// 同じ面の連続と, 向かい合う面の順序違いを除く
+// Skip repeated faces and the redundant order of opposite faces
+bool redundant(int face, int lastFace) {
+    return lastFace >= 0 && (face == lastFace || (face % 3 == lastFace % 3 && face < lastFace));
+}
+
+bool phase2(Search &s, int corner, int edge8, int slicePerm, int center, int depth, int togo) {
+    if (s.stopped()) return true;
+    if (togo == 0) {
+        if (corner == 0 && edge8 == 0 && slicePerm == 0 && center == 0) {
+            s.length = depth;
+            if (s.onSolution) s.onSolution(s.moves, depth);
+            // 以降はこれより短い解だけを探す / From now on only look for shorter solutions
+            if (s.keepImproving) s.maxLength = depth - 1;
+            return true;
+        }
+        return false;
+    }
+    const int lastFace = depth > 0 ? s.moves[depth - 1] / 3 : -1;
+    for (int fm : PHASE2_MOVES) {
+        if (redundant(fm / 3, lastFace)) continue;
+        const int c = tables.cornerMove[(size_t)corner * NUM_FACE_MOVES + fm];
+        const int e = tables.edge8Move[(size_t)edge8 * NUM_FACE_MOVES + fm];
+        const int p = tables.slicePermMove[slicePerm * NUM_FACE_MOVES + fm];
+        const int x = s.fixCenters ? tables.center2Move[center * NUM_FACE_MOVES + fm] : 0;
+        int h = std::max(tables.cornerSlicePrun[c * N_SLICE_PERM + p], tables.edge8SlicePrun[e * N_SLICE_PERM + p]);
+        if (s.fixCenters) h = std::max<int>(h, tables.cornerCenterPrun[(size_t)c * N_CENTER2 + x]);
+        if (h > togo - 1) continue;
+        s.moves[depth] = fm;
+        if (phase2(s, c, e, p, x, depth + 1, togo - 1)) return true;
+    }
+    return false;
+}
+
+// フェーズ1の解が見つかったら, その手を適用した状態からフェーズ2を始める
+// Once phase 1 is done, start phase 2 from the state reached by the phase 1 moves
+bool startPhase2(Search &s, int depth1) {
+    // フェーズ1の最後の手がフェーズ2の手なら, より短いフェーズ1で既に試している
+    // If phase 1 ends with a phase 2 move, a shorter phase 1 already covered this case
+    if (depth1 > 0 && isPhase2Move(s.moves[depth1 - 1])) return false;
+
+    CubeState c = s.start;
+    for (int i = 0; i < depth1; ++i) {
+        const int fm = s.moves[i];
+        for (int p = 0; p <= fm % 3; ++p) c.apply(FACE_QUARTER[fm / 3]);
+    }
+    const int corner = getCorner(c), edge8 = getEdge8(c), slicePerm = getSlicePerm(c);
+    const int center = s.fixCenters ? getCenter2(c) : 0;
+    int h = std::max(tables.cornerSlicePrun[corner * N_SLICE_PERM + slicePerm],
+                     tables.edge8SlicePrun[edge8 * N_SLICE_PERM + slicePerm]);
+    if (s.fixCenters) h = std::max<int>(h, tables.cornerCenterPrun[(size_t)corner * N_CENTER2 + center]);
+    const int limit = std::min(s.maxLength - depth1, s.fixCenters ? MAX_PHASE2_LENGTH_CENTERS : MAX_PHASE2_LENGTH);
+    for (int depth2 = h; depth2 <= limit; ++depth2) {
+        if (phase2(s, corner, edge8, slicePerm, center, depth1, depth2)) return s.aborted || !s.keepImproving;
+    }
+    return false;
+}
+
+bool phase1(Search &s, int twist, int flip, int slice, int center, int depth, int togo) {
+    if (s.stopped()) return true;
+    if (togo == 0) return startPhase2(s, depth);
+
+    const int lastFace = depth > 0 ? s.moves[depth - 1] / 3 : -1;
+    for (int fm = 0; fm < NUM_FACE_MOVES; ++fm) {
+        if (redundant(fm / 3, lastFace)) continue;
+        const int t = tables.twistMove[twist * NUM_FACE_MOVES + fm];
+        const int f = tables.flipMove[flip * NUM_FACE_MOVES + fm];
+        const int sl = tables.sliceMove[slice * NUM_FACE_MOVES + fm];
+        const int x = s.fixCenters ? tables.centerParityMove[center * NUM_FACE_MOVES + fm] : 0;
+        int h = std::max(tables.twistSlicePrun[t * N_SLICE + sl], tables.flipSlicePrun[f * N_SLICE + sl]);
+        if (s.fixCenters) h = std::max<int>(h, tables.twistCenterPrun[t * N_CENTER_PARITY + x]);
+        if (h > togo - 1) continue;
+        s.moves[depth] = fm;
+        if (phase1(s, t, f, sl, x, depth + 1, togo - 1)) return true;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// センターの扱い / Centres
+// ---------------------------------------------------------------------------
+
+// 全体の1/4回転 (3つの層を同じ向きに回す) / Whole-cube quarter turn (all three layers)
+void applyWholeTurn(CubeState &s, int axis, bool clockwise) {
+    for (int index = 0; index < 3; ++index) s.apply(makeMove(axis, index, clockwise));
+}
+
+bool centersHome(const CubeState &s) {
+    for (int i = 0; i < 6; ++i) {
+        if (s.xp[i] != i) return false;
+    }
+    return true;
+}
+
+// 全体を回してセンターを元の位置に戻す (E/F/Vの中層回しでセンターが動くため)
+// Rotate the whole cube so the centres are back home (middle-slice turns move them)
+bool normalizeCenters(CubeState &s) {
+    for (int n = 0; n <= 3; ++n) {
+        const int count = n == 0 ? 1 : (n == 1 ? 6 : (n == 2 ? 36 : 216));
+        for (int code = 0; code < count; ++code) {
+            CubeState t = s;
+            int c = code;
+            for (int i = 0; i < n; ++i, c /= 6) applyWholeTurn(t, (c % 6) / 2, (c % 2) == 0);
+            if (centersHome(t)) {
+                s = t;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// 隣り合う逆手を打ち消し, 同じ手の3連続を逆手1つにまとめる
+// Cancel adjacent inverse moves and fold three identical moves into one inverse move
+void simplify(std::vector<CubeMove> &moves) {
+    std::vector<CubeMove> out;
+    for (CubeMove m : moves) {
+        const size_t n = out.size();
+        if (n > 0 && out[n - 1] == inverseMove(m)) {
+            out.pop_back();
+        } else if (n > 1 && out[n - 1] == m && out[n - 2] == m) {
+            out.resize(n - 2);
+            out.push_back(inverseMove(m));
+        } else {
+            out.push_back(m);
+        }
+    }
+    moves.swap(out);
+}
+
+// センターが元の位置に来るように全体を回した状態を探索の初期状態にする
+// 戻り値は解を元の向きに写すための回転 (失敗したら-1)
+// Start the search from the whole cube turned so that the centres are home.
+// Returns the rotation mapping the solution back to the original frame (-1 on failure)
+int prepareSearch(const CubeState &state, bool fixCenters, Search &s) {
+    int slotU = 0, slotR = 0;
+    for (int i = 0; i < 6; ++i) {
+        if (state.xp[i] == 0) slotU = i;
+        if (state.xp[i] == 1) slotR = i;
+    }
+    const int toHome = findRotation(CENTER_POS[slotU], CENTER_POS[0], CENTER_POS[slotR], CENTER_POS[1]);
+    s.start = state;
+    s.fixCenters = fixCenters;
+    if (toHome < 0 || !normalizeCenters(s.start)) return -1;
+    return inverseRotation(toHome);
+}
+
+void runSearch(Search &s, int maxLength) {
+    const int twist = getTwist(s.start), flip = getFlip(s.start), slice = getSlice(s.start);
+    const int center = s.fixCenters ? getCenterParity(s.start) : 0;
+    int h = std::max(tables.twistSlicePrun[twist * N_SLICE + slice], tables.flipSlicePrun[flip * N_SLICE + slice]);
+    if (s.fixCenters) h = std::max<int>(h, tables.twistCenterPrun[twist * N_CENTER_PARITY + center]);
+    for (s.maxLength = std::max(maxLength, 1); s.length < 0 && !s.aborted && s.maxLength <= MAX_SOLUTION_LENGTH; s.maxLength += 2) {
+        for (int depth1 = h; depth1 <= s.maxLength; ++depth1) {
+            if (phase1(s, twist, flip, slice, center, 0, depth1)) break;
+        }
+    }
+}
+
+// 面回転の列をアプリの1/4回転の列に直し, 元の向きに写す
+// Convert face moves to the app's quarter turns and map them back to the original frame
+void toCubeMoves(const int *faceMoves, int length, int toState, std::vector<CubeMove> &moves) {
+    std::vector<CubeMove> local;
+    for (int i = 0; i < length; ++i) {
+        const int fm = faceMoves[i];
+        const CubeMove q = FACE_QUARTER[fm / 3];
+        if (fm % 3 == 2) {
+            local.push_back(inverseMove(q));
+        } else {
+            for (int p = 0; p <= fm % 3; ++p) local.push_back(q);
+        }
+    }
+    simplify(local);
+
+    moves.clear();
+    for (CubeMove m : local) moves.push_back(rotateMove(m, toState));
+}
+
+}  // namespace
+
+bool initSolverTables(const std::string &cacheFile, const std::atomic<bool> *cancel) {
+    // ソルバーとスクランブルのワーカーが同時に呼んでも表は1回だけ作る.
+    // 他方が作っている間もキャンセルに気づけるよう, ロックは短い間隔で取り直す
+    // The solver and scramble workers may both get here; the tables are built only once.
+    // The lock is retried at short intervals so a cancel is noticed while the other one builds.
+    static std::timed_mutex initMutex;
+    std::unique_lock<std::timed_mutex> lock(initMutex, std::defer_lock);
+    while (!lock.try_lock_for(std::chrono::milliseconds(10))) {
+        if (cancelled(cancel)) return false;
+    }
+    if (tables.ready) return true;
+    if (!loadTables(cacheFile)) {
+        printf("Generating solver tables...\n");
+        if (!generateTables(cancel)) return false;
+        saveTables(cacheFile);
+    }
+    tables.ready = true;
+    return true;
+}
+
+bool solverTablesReady() {
+    return tables.ready;
+}
+
+bool solveCube(const CubeState &state, std::vector<CubeMove> &moves, bool fixCenters, int maxLength,
+               const std::atomic<bool> *cancel) {
+    moves.clear();
+    if (!tables.ready) return false;
+
+    Search s;
+    const int toState = prepareSearch(state, fixCenters, s);
+    if (toState < 0) return false;
+    s.cancel = cancel;
+    runSearch(s, fixCenters ? maxLength + CENTER_EXTRA_LENGTH : maxLength);
+    if (s.length < 0) return false;
+    toCubeMoves(s.moves, s.length, toState, moves);
+    return true;
+}
+
+bool solveCubeProgressive(const CubeState &state, bool fixCenters, const std::atomic<bool> &cancel,
+                          double timeLimit, const SolutionCallback &onSolution) {
+    if (!tables.ready) return false;
+
+    Search s;
+    const int toState = prepareSearch(state, fixCenters, s);
+    if (toState < 0) return false;
+    s.keepImproving = true;
+    s.cancel = &cancel;
+    s.deadline = std::chrono::steady_clock::now() +
+                 std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeLimit));
+    s.onSolution = [&](const int *faceMoves, int length) {
+        std::vector<CubeMove> moves;
+        toCubeMoves(faceMoves, length, toState, moves);
+        onSolution(moves);
+    };
+
+    // 最初の解を素早く得るために長めの上限から始め, 見つかるたびに縮める
+    // Start with a loose bound so the first solution comes quickly, then tighten it
+    runSearch(s, MAX_SOLUTION_LENGTH);
+    return s.length >= 0;
+}
+
+// ---------------------------------------------------------------------------
+// AsyncSolver
+// ---------------------------------------------------------------------------
+
+AsyncSolver::~AsyncSolver() {
+    shutdown();
+}
+
+void AsyncSolver::start(const CubeState &state, bool fixCenters, const std::string &cacheFile, double timeLimit) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // 最初の探索でワーカーを起動する / The worker is started by the first search
+        if (!thread_.joinable()) {
+            stopping_ = false;
+            thread_ = std::thread(&AsyncSolver::workerLoop, this);
+        }
+        // 走っている探索はフラグを見て止まり, ワーカーはこの要求に移る
+        // A running search stops at the flag and the worker moves on to this request
+        request_ = { state, fixCenters, cacheFile, timeLimit };
+        hasRequest_ = true;
+        ++generation_;
+        cancel_ = true;
+        best_.clear();
+        bestLength_ = -1;
+        status_ = SEARCHING;
+    }
+    wake_.notify_one();
+}
+
+void AsyncSolver::workerLoop() {
+    for (;;) {
+        Request request;
+        int generation;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this]() { return stopping_ || hasRequest_; });
+            if (stopping_) return;
+            request = std::move(request_);
+            hasRequest_ = false;
+            generation = generation_;
+            cancel_ = false;
+        }
+
+        // 面回転の手数が減っても半回転の数次第で1/4回転の数は増えることがあるので, 短い時だけ採用する
+        // Fewer face turns can still mean more quarter turns (half turns count twice), so only keep shorter ones
+        auto keepShorter = [this, generation](const std::vector<CubeMove> &moves) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (generation != generation_) return;
+            if (bestLength_ >= 0 && (int)moves.size() >= bestLength_) return;
+            best_ = moves;
+            bestLength_ = (int)moves.size();
+        };
+
+        // 表の生成は終了時にだけやめる (キャンセルされても作り終えれば次の探索で使える)
+        // Table generation stops only at shutdown; finished tables serve the next search even after a cancel
+        if (initSolverTables(request.cacheFile, &stopping_)) {
+            solveCubeProgressive(request.state, request.fixCenters, cancel_, request.timeLimit, keepShorter);
+        }
+
+        // キャンセルされたか次の探索が来ていれば, 状態はそちらに任せる
+        // If cancelled or superseded meanwhile, the status belongs to the newer call
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (generation == generation_ && !stopping_) status_ = DONE;
+    }
+}
+
+void AsyncSolver::cancel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    hasRequest_ = false;
+    ++generation_;
+    cancel_ = true;
+    status_ = IDLE;
+}
+
+int AsyncSolver::best(std::vector<CubeMove> *moves) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (moves != nullptr) *moves = best_;
+    return bestLength_;
+}
+
+void AsyncSolver::reset() {
+    status_ = IDLE;
+}
+
+void AsyncSolver::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        cancel_ = true;
+        hasRequest_ = false;
+        ++generation_;
+        status_ = IDLE;
+    }
+    wake_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
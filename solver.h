@@ -0,0 +1,106 @@
+#ifndef _SOLVER_H_
+#define _SOLVER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cube_state.h"
+
+// Kociembaの2フェーズ法によるソルバー
+// フェーズ1: 全ての面回転で, 角・辺の向きを揃えE層の辺をE層に集める (部分群 <U,D,R2,L2,F2,B2> へ)
+// フェーズ2: 部分群の手 <U,D,R2,L2,F2,B2> だけで残りを揃える
+// Two-phase solver after Kociemba.
+// Phase 1 uses all face turns to fix corner/edge orientations and bring the E-slice
+// edges into the E slice (i.e. into the subgroup <U,D,R2,L2,F2,B2>).
+// Phase 2 solves the rest using only moves from that subgroup.
+// センターの向きも揃える時は, フェーズ1で側面センターの向きを偶数にし, フェーズ2で全て揃える
+// When centre orientations are fixed too, phase 1 also makes the side-centre twists even
+// and phase 2 turns every centre home.
+
+// 手の表と枝刈り表を用意する. キャッシュファイルがあれば読み込み, 無ければ生成して保存する.
+// cancelが立つと生成を途中でやめてfalseを返す (次の呼び出しで作り直す)
+// Prepare move and pruning tables: load them from the cache file, or generate and save them.
+// Generation stops and returns false once cancel is set (the next call starts over).
+bool initSolverTables(const std::string &cacheFile, const std::atomic<bool> *cancel = nullptr);
+bool solverTablesReady();
+
+// 状態を揃える手順をアプリの1/4回転の列として求める
+// maxLength: 面回転 (半回転も1手と数える) の手数の上限. 見つからなければ上限を緩めて探す
+// fixCenters: センターの向きも揃える (ArtModeで面の絵を元に戻すため)
+// cancelが立つと探索をやめてfalseを返す
+// Find a sequence of quarter turns (in the app's move encoding) that solves the state.
+// maxLength is the face-turn-metric budget (relaxed if nothing is found);
+// fixCenters also restores the centre orientations (needed for ArtMode pictures).
+// The search gives up and returns false once cancel is set.
+bool solveCube(const CubeState &state, std::vector<CubeMove> &moves, bool fixCenters, int maxLength = 21,
+               const std::atomic<bool> *cancel = nullptr);
+
+// 解を見つけるたびにonSolutionへ渡し, より短い解を探し続ける
+// cancelが立つか, timeLimit秒が過ぎるか, これ以上短い解が見つからなくなると戻る
+// Report each solution to onSolution and keep searching for shorter ones.
+// Returns when cancel is set, timeLimit seconds have passed or no shorter solution is left.
+using SolutionCallback = std::function<void(const std::vector<CubeMove> &moves)>;
+bool solveCubeProgressive(const CubeState &state, bool fixCenters, const std::atomic<bool> &cancel,
+                          double timeLimit, const SolutionCallback &onSolution);
+
+// 別スレッドで解を探す. メインループは毎フレームstatus()とbest()を見るだけでよい
+// ワーカーは1本を使い回し, どのメンバー関数もワーカーを待たない (shutdown()を除く)
+// Searches for a solution on a worker thread; the main loop only polls status() and best().
+// One worker is reused for every search, and no member function waits for it (except shutdown()).
+class AsyncSolver {
+public:
+    enum Status { IDLE, SEARCHING, DONE };
+
+    ~AsyncSolver();
+
+    // 探索を始める (前の探索はキャンセルする). 前の探索が止まり次第ワーカーが始めるので, ここでは待たない.
+    // 表の読み込みもワーカーで行う
+    // Start a search, cancelling the previous one. The worker picks it up as soon as the previous
+    // search has stopped, so this never waits. Tables are loaded on the worker as well
+    void start(const CubeState &state, bool fixCenters, const std::string &cacheFile, double timeLimit);
+    // 探索を止めてIDLEに戻る. 表の生成中なら生成は続け, 次の探索に使う
+    // Stop the search and go back to IDLE. Table generation in progress carries on for the next search
+    void cancel();
+    // DONEの結果を受け取った後にIDLEへ戻す / Go back to IDLE after consuming a DONE result
+    void reset();
+    // 探索も表の生成もやめてワーカーを終わらせる. 終了時, 他のファイルの静的変数 (表) が
+    // 破棄される前に呼ぶ
+    // Abandon the search and any table generation and join the worker. Call at exit, before
+    // statics in other files (the tables) are destroyed
+    void shutdown();
+
+    Status status() const { return status_; }
+    // これまでで最短の解 (無ければ-1) / Best solution so far (-1 if none)
+    int best(std::vector<CubeMove> *moves = nullptr);
+
+private:
+    struct Request {
+        CubeState state;
+        bool fixCenters = false;
+        std::string cacheFile;
+        double timeLimit = 0.0;
+    };
+
+    void workerLoop();
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    Request request_;
+    bool hasRequest_ = false;
+    // start()とcancel()のたびに増える. 古い探索の結果を捨てるために使う
+    // Bumped by every start() and cancel(); results of older searches are dropped
+    int generation_ = 0;
+    std::atomic<bool> cancel_{ false };
+    std::atomic<bool> stopping_{ false };
+    std::atomic<Status> status_{ IDLE };
+    std::vector<CubeMove> best_;
+    int bestLength_ = -1;
+};
+
+#endif  // _SOLVER_H_
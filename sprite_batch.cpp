@@ -0,0 +1,123 @@
+#include "sprite_batch.h"
+
+#include <cstddef>
+#include <cstring>
+
+static const int VERTICES_PER_SPRITE = 6;
+
+void SpriteBatch::init(int maxSprites) {
+    // 1フレーム分の数倍を確保し, 使い切ったら捨てて (オーファン) 先頭から書き直す
+    // Reserve several frames' worth; when it runs out the buffer is orphaned and refilled from the start
+    capacity_ = (GLsizeiptr)maxSprites * VERTICES_PER_SPRITE * 4;
+    writeOffset_ = 0;
+    vertices_.reserve((size_t)maxSprites * VERTICES_PER_SPRITE);
+    uploaded_.reserve((size_t)maxSprites * VERTICES_PER_SPRITE);
+    batches_.reserve(16);
+
+    vao_ = GLVertexArray::create();
+    glBindVertexArray(vao_);
+
+    vbo_ = GLBuffer::create();
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    glBufferData(GL_ARRAY_BUFFER, capacity_ * sizeof(SpriteVertex), NULL, GL_STREAM_DRAW);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void *)offsetof(SpriteVertex, position));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void *)offsetof(SpriteVertex, texcoord));
+    glEnableVertexAttribArray(8);
+    glVertexAttribPointer(8, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void *)offsetof(SpriteVertex, tint));
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    const unsigned char white[4] = { 255, 255, 255, 255 };
+    whiteTex_ = GLTexture::create();
+    glBindTexture(GL_TEXTURE_2D, whiteTex_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void SpriteBatch::release() {
+    whiteTex_.reset();
+    vbo_.reset();
+    vao_.reset();
+    vertices_.clear();
+    batches_.clear();
+    uploaded_.clear();
+}
+
+void SpriteBatch::sprite(GLuint texture, const glm::vec2 &min, const glm::vec2 &max,
+                         const glm::vec2 &uvMin, const glm::vec2 &uvMax, const glm::vec4 &tint) {
+    // 同じテクスチャが続く間は同じ描画にまとめる / Extend the current draw while the texture stays the same
+    const int first = (int)vertices_.size();
+    if (batches_.empty() || batches_.back().texture != texture) {
+        batches_.push_back({ texture, first, 0 });
+    }
+    batches_.back().count += VERTICES_PER_SPRITE;
+
+    const SpriteVertex v00 = { glm::vec3(min.x, min.y, 0.0f), glm::vec2(uvMin.x, uvMin.y), tint };
+    const SpriteVertex v10 = { glm::vec3(max.x, min.y, 0.0f), glm::vec2(uvMax.x, uvMin.y), tint };
+    const SpriteVertex v11 = { glm::vec3(max.x, max.y, 0.0f), glm::vec2(uvMax.x, uvMax.y), tint };
+    const SpriteVertex v01 = { glm::vec3(min.x, max.y, 0.0f), glm::vec2(uvMin.x, uvMax.y), tint };
+    vertices_.push_back(v00);
+    vertices_.push_back(v10);
+    vertices_.push_back(v11);
+    vertices_.push_back(v00);
+    vertices_.push_back(v11);
+    vertices_.push_back(v01);
+}
+
+void SpriteBatch::quad(const glm::vec2 &min, const glm::vec2 &max, const glm::vec4 &color) {
+    sprite(whiteTex_, min, max, glm::vec2(0.0f), glm::vec2(1.0f), color);
+}
+
+void SpriteBatch::flush() {
+    if (vertices_.empty()) {
+        batches_.clear();
+        return;
+    }
+
+    // 前回と同じ頂点なら転送せず, 前回書き込んだ場所をそのまま描く
+    // If the vertices are unchanged, skip the upload and draw what was written last time
+    const GLsizeiptr count = (GLsizeiptr)vertices_.size();
+    const bool unchanged = uploaded_.size() == vertices_.size() &&
+                           std::memcmp(uploaded_.data(), vertices_.data(), vertices_.size() * sizeof(SpriteVertex)) == 0;
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    if (!unchanged) {
+        if (writeOffset_ + count > capacity_) {
+            // 使い切ったらバッファを捨てて先頭から (GPUが使用中の領域を待たずに済む)
+            // Orphan the buffer when it is full so we never wait for the GPU to finish with it
+            if (count > capacity_) capacity_ = count * 4;
+            glBufferData(GL_ARRAY_BUFFER, capacity_ * sizeof(SpriteVertex), NULL, GL_STREAM_DRAW);
+            writeOffset_ = 0;
+        }
+        void *dst = glMapBufferRange(GL_ARRAY_BUFFER, writeOffset_ * sizeof(SpriteVertex), count * sizeof(SpriteVertex),
+                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (dst != nullptr) {
+            std::memcpy(dst, vertices_.data(), count * sizeof(SpriteVertex));
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+        uploaded_.assign(vertices_.begin(), vertices_.end());
+        uploadedOffset_ = writeOffset_;
+        writeOffset_ += count;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glBindVertexArray(vao_);
+    glActiveTexture(GL_TEXTURE0);
+    for (const Batch &batch : batches_) {
+        glBindTexture(GL_TEXTURE_2D, batch.texture);
+        glDrawArrays(GL_TRIANGLES, (GLint)(uploadedOffset_ + batch.first), batch.count);
+    }
+    glBindVertexArray(0);
+    glDisable(GL_BLEND);
+
+    vertices_.clear();
+    batches_.clear();
+}
@@ -0,0 +1,62 @@
+#ifndef _SPRITE_BATCH_H_
+#define _SPRITE_BATCH_H_
+
+#include <vector>
+
+#include <glad/gl.h>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "gl_resource.h"
+
+// 2Dのスプライトと四角形をまとめて描くクラス (設定画面やHUD用)
+// VAOと頂点バッファは一度だけ作り, 頂点は使い回すストリーミング用バッファに書き込む.
+// 同じテクスチャが続くスプライトは1回の描画にまとめ, 前のフレームと同じ内容なら転送もしない
+// Batched 2D sprites and quads (setting screen, HUD). The VAO and vertex buffer are
+// created once and vertices are streamed into a reused buffer; consecutive sprites
+// sharing a texture become one draw, and unchanged frames skip the upload entirely.
+//
+// 頂点属性はrender.vertの2D描画 (u_mode == 2) に合わせる: 0=位置, 2=UV, 8=色
+// Vertex attributes match the 2D path of render.vert (u_mode == 2): 0 = position, 2 = UV, 8 = tint
+class SpriteBatch {
+public:
+    void init(int maxSprites = 256);
+    void release();
+
+    // 画面座標 (左下が原点, ピクセル) の矩形にテクスチャを貼る
+    // Draw a textured rectangle in window coordinates (origin bottom-left, pixels)
+    void sprite(GLuint texture, const glm::vec2 &min, const glm::vec2 &max,
+                const glm::vec2 &uvMin = glm::vec2(0.0f, 1.0f), const glm::vec2 &uvMax = glm::vec2(1.0f, 0.0f),
+                const glm::vec4 &tint = glm::vec4(1.0f));
+    // 単色の四角形 / Solid-colour rectangle
+    void quad(const glm::vec2 &min, const glm::vec2 &max, const glm::vec4 &color);
+
+    // 溜めたスプライトを描いて空にする. 呼ぶ前に2D用のシェーダ設定を済ませておく
+    // Draw and clear the queued sprites; the 2D shader state must already be set
+    void flush();
+
+private:
+    struct SpriteVertex {
+        glm::vec3 position;
+        glm::vec2 texcoord;
+        glm::vec4 tint;
+    };
+    struct Batch {
+        GLuint texture;
+        int first, count;
+    };
+
+    GLVertexArray vao_;
+    GLBuffer vbo_;
+    GLTexture whiteTex_;              // 単色の四角形用の1x1の白 / 1x1 white texture for solid quads
+    GLsizeiptr capacity_ = 0;         // 頂点バッファの大きさ (頂点数) / Buffer size in vertices
+    GLsizeiptr writeOffset_ = 0;      // 次に書き込む位置 (頂点数) / Next write position in vertices
+
+    std::vector<SpriteVertex> vertices_;
+    std::vector<Batch> batches_;
+    std::vector<SpriteVertex> uploaded_;  // 最後に転送した頂点 / Last uploaded vertices
+    GLsizeiptr uploadedOffset_ = 0;
+};
+
+#endif  // _SPRITE_BATCH_H_
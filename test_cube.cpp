@@ -0,0 +1,225 @@
+// GLを使わない部分 (状態モデル, ソルバー, スクランブル) のテスト. make testで実行する
+// Tests for the GL-free logic (cube state model, solver and scrambler); run with make test
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "cube_state.h"
+#include "scrambler.h"
+#include "solver.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++failures; \
+        } \
+    } while (0)
+
+static const char *TABLE_FILE = "cache/solver_tables.bin";
+
+// 角と辺だけを比べる (通常モードではセンターの向きを揃えない)
+// Compare corners and edges only (normal mode leaves centre orientations alone)
+static bool piecesEqual(const CubeState &a, const CubeState &b) {
+    for (int i = 0; i < 8; ++i)
+        if (a.cp[i] != b.cp[i] || a.co[i] != b.co[i]) return false;
+    for (int i = 0; i < 12; ++i)
+        if (a.ep[i] != b.ep[i] || a.eo[i] != b.eo[i]) return false;
+    return true;
+}
+
+template <int N>
+static int permutationParity(const uint8_t (&p)[N]) {
+    int parity = 0;
+    for (int i = 0; i < N; ++i)
+        for (int j = i + 1; j < N; ++j)
+            if (p[j] < p[i]) parity ^= 1;
+    return parity;
+}
+
+// 面回転の手数 (同じ手の連続を1手と数える) / Face-turn count (runs of the same move count once)
+static int faceTurns(const std::vector<CubeMove> &moves) {
+    int count = 0;
+    for (size_t i = 0; i < moves.size(); ++i) {
+        if (i == 0 || moves[i] != moves[i - 1]) ++count;
+    }
+    return count;
+}
+
+// 全体の1/4回転 (3つの層を同じ向きに回す) / Whole-cube quarter turn (all three layers)
+static void applyWholeTurn(CubeState &s, int axis, bool clockwise) {
+    for (int index = 0; index < 3; ++index) s.apply(makeMove(axis, index, clockwise));
+}
+
+// 全体を回せば揃った状態になるか. withCentersならセンターの向きも比べる
+// Whether some whole-cube rotation turns s into the solved state (centre orientations too if withCenters)
+static bool solvedUpToRotation(const CubeState &s, bool withCenters) {
+    const CubeState solved = CubeState::solved();
+    // 3手以内の全体回転で24通りの向きを全て尽くせる / Up to three whole turns reach all 24 rotations
+    for (int n = 0; n <= 3; ++n) {
+        int count = 1;
+        for (int i = 0; i < n; ++i) count *= 6;
+        for (int code = 0; code < count; ++code) {
+            CubeState t = s;
+            for (int i = 0, c = code; i < n; ++i, c /= 6) applyWholeTurn(t, (c % 6) / 2, (c % 2) == 0);
+            if (withCenters ? t == solved : piecesEqual(t, solved)) return true;
+        }
+    }
+    return false;
+}
+
+// 小立方体の回転で初期位置が今の位置へ写ること / Each cubie's rotation maps its home to its position
+static bool placementsConsistent(const CubeState &s) {
+    CubiePlacement p[27];
+    s.placements(p);
+    for (const CubiePlacement &c : p) {
+        const int (&r)[3][3] = cubeRotation(c.rotation);
+        for (int row = 0; row < 3; ++row) {
+            int v = 0;
+            for (int k = 0; k < 3; ++k) v += r[row][k] * (c.home[k] - 1);
+            if (v != c.position[row] - 1) return false;
+        }
+    }
+    return true;
+}
+
+static void testMoves() {
+    const CubeState solved = CubeState::solved();
+    for (int m = 0; m < NUM_CUBE_MOVES; ++m) {
+        CubeState s = solved;
+        s.apply((CubeMove)m);
+        CHECK(!(s == solved));
+        CHECK(placementsConsistent(s));
+        s.apply(inverseMove((CubeMove)m));
+        CHECK(s == solved);
+
+        s = solved;
+        for (int i = 0; i < 4; ++i) s.apply((CubeMove)m);
+        CHECK(s == solved);
+    }
+
+    // 乱択の手順と, その逆順の逆手で元に戻る / A random sequence undone by its reversed inverse
+    std::mt19937_64 rng(1);
+    for (int trial = 0; trial < 100; ++trial) {
+        std::vector<CubeMove> moves(40);
+        for (CubeMove &m : moves) m = (CubeMove)(rng() % NUM_CUBE_MOVES);
+        CubeState s = solved;
+        s.apply(moves.data(), (int)moves.size());
+        CHECK(placementsConsistent(s));
+        for (auto it = moves.rbegin(); it != moves.rend(); ++it) s.apply(inverseMove(*it));
+        CHECK(s == solved);
+
+        CubiePlacement p[27];
+        s.placements(p);
+        for (const CubiePlacement &c : p) {
+            CHECK(c.rotation == 0);
+            CHECK(c.home[0] == c.position[0] && c.home[1] == c.position[1] && c.home[2] == c.position[2]);
+        }
+    }
+}
+
+static void testRandomStates() {
+    for (uint64_t seed = 0; seed < 200; ++seed) {
+        const CubeState s = randomCubeState(seed, true);
+        int twist = 0, flip = 0, centerTwist = 0;
+        for (int i = 0; i < 8; ++i) twist += s.co[i];
+        for (int i = 0; i < 12; ++i) flip += s.eo[i];
+        for (int i = 0; i < 6; ++i) centerTwist += s.xo[i];
+        const int cornerParity = permutationParity(s.cp);
+        CHECK(twist % 3 == 0);
+        CHECK(flip % 2 == 0);
+        CHECK(cornerParity == permutationParity(s.ep));
+        CHECK(centerTwist % 2 == cornerParity);
+        CHECK(randomCubeState(seed, true) == s);
+    }
+}
+
+static void testSolver() {
+    for (int art = 0; art < 2; ++art) {
+        for (uint64_t seed = 1000; seed < 1020; ++seed) {
+            const CubeState start = randomCubeState(seed, art != 0);
+            std::vector<CubeMove> moves;
+            CHECK(solveCube(start, moves, art != 0));
+            CubeState s = start;
+            s.apply(moves.data(), (int)moves.size());
+            CHECK(art ? s == CubeState::solved() : piecesEqual(s, CubeState::solved()));
+            // 通常は21手以内, センターも揃える時は上限を緩めた分まで
+            // Normally within 21 face turns; with centres, within the relaxed bound
+            CHECK(faceTurns(moves) <= (art ? 30 : 21));
+        }
+    }
+}
+
+// 中層回しと全体回しを含む手順で崩すと, センターが元の位置にない状態から解くことになる.
+// 解の後は全体の向きを除いて揃い, ArtModeではセンターの向きも戻っていること
+// Scrambling with slice moves and whole-cube turns leaves the centres away from home.
+// The solution must solve the cube up to a whole-cube rotation, including the
+// centre orientations when they are fixed.
+static void testSliceScrambles() {
+    std::mt19937_64 rng(7);
+    for (int art = 0; art < 2; ++art) {
+        for (int trial = 0; trial < 20; ++trial) {
+            CubeState start = CubeState::solved();
+            for (int i = 0; i < 30; ++i) {
+                const CubeMove m = (CubeMove)(rng() % NUM_CUBE_MOVES);
+                // 中層を多めに混ぜる / Bias towards middle slices
+                start.apply(rng() % 2 ? makeMove(moveAxis(m), 1, moveClockwise(m)) : m);
+            }
+            applyWholeTurn(start, (int)(rng() % 3), rng() % 2 == 0);
+
+            std::vector<CubeMove> moves;
+            CHECK(solveCube(start, moves, art != 0));
+            CubeState s = start;
+            s.apply(moves.data(), (int)moves.size());
+            CHECK(solvedUpToRotation(s, art != 0));
+            CHECK(faceTurns(moves) <= (art ? 30 : 21));
+        }
+    }
+}
+
+static void testScrambles() {
+    for (int art = 0; art < 2; ++art) {
+        std::vector<CubeMove> a, b;
+        CHECK(randomScramble(42, art != 0, a));
+        CHECK(randomScramble(42, art != 0, b));
+        CHECK(a == b);
+
+        // スクランブルは揃った状態からそのseedの状態を作る / The scramble builds the seed's state
+        CubeState s = CubeState::solved();
+        s.apply(a.data(), (int)a.size());
+        const CubeState target = randomCubeState(42, art != 0);
+        CHECK(art ? s == target : piecesEqual(s, target));
+
+        // 並列に作っても順番と中身は同じ / Parallel generation gives the same scrambles in seed order
+        std::vector<std::vector<CubeMove>> bulk;
+        randomScrambles(40, 4, art != 0, bulk, 3);
+        CHECK(bulk.size() == 4);
+        for (int i = 0; i < (int)bulk.size(); ++i) {
+            std::vector<CubeMove> single;
+            randomScramble(40 + i, art != 0, single);
+            CHECK(bulk[i] == single);
+        }
+    }
+}
+
+int main() {
+    testMoves();
+    testRandomStates();
+
+    if (!initSolverTables(TABLE_FILE)) {
+        fprintf(stderr, "Failed to prepare solver tables\n");
+        return 1;
+    }
+    testSolver();
+    testSliceScrambles();
+    testScrambles();
+
+    if (failures > 0) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All tests passed.\n");
+    return 0;
+}
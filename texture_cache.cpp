@@ -0,0 +1,431 @@
+#include "texture_cache.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+// ---------------------------------------------------------------------------
+// キャッシュファイル / Cache file
+// ---------------------------------------------------------------------------
+// [ヘッダ][段ごとの位置と大きさ][各段のデータ (16バイト境界)]
+// [header][offset and size of each level][level data, 16-byte aligned]
+
+const char TEXTURE_CACHE_MAGIC[8] = { 'C', 'C', 'T', 'E', 'X', 'T', 'R', '1' };
+
+struct TextureCacheHeader {
+    char magic[8];
+    uint32_t format;
+    uint32_t compression;  // 作った時にBC1が使えたか / Whether BC1 was available when built
+    int32_t width;
+    int32_t height;
+    int32_t levelCount;
+    int32_t reserved;
+    int64_t sourceTime;
+    uint64_t sourceSize;
+    uint64_t sourceHash;
+};
+
+struct TextureCacheLevel {
+    uint64_t offset;
+    uint64_t size;
+};
+
+static size_t levelSize(GLenum format, int width, int height) {
+    if (format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) {
+        // 4x4画素のブロックごとに8バイト / 8 bytes per 4x4 block
+        return (size_t)((width + 3) / 4) * ((height + 3) / 4) * 8;
+    }
+    return (size_t)width * height * 4;
+}
+
+static size_t alignOffset(size_t offset) {
+    return (offset + 15) & ~(size_t)15;
+}
+
+// ヘッダの元画像の時刻と大きさだけを書き換える (段のデータはそのまま)
+// Rewrite only the source time and size in the header; the level data stays as it is
+static void updateSourceStamp(const std::string &path, int64_t time, uint64_t size) {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file.is_open()) return;
+    file.seekp(offsetof(TextureCacheHeader, sourceTime));
+    file.write((const char *)&time, sizeof(time));
+    file.seekp(offsetof(TextureCacheHeader, sourceSize));
+    file.write((const char *)&size, sizeof(size));
+}
+
+// ---------------------------------------------------------------------------
+// ミップマップとBC1 / Mip chain and BC1
+// ---------------------------------------------------------------------------
+
+int mipLevelCount(int width, int height) {
+    int count = 1;
+    while (width > 1 || height > 1) {
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+        ++count;
+    }
+    return count;
+}
+
+// 2x2画素の平均で半分の大きさにする (奇数の端は繰り返す)
+// Halve an RGBA8 image by averaging 2x2 pixels (odd edges repeat)
+static void downsample(const unsigned char *src, int width, int height, unsigned char *dst, int dstWidth, int dstHeight) {
+    for (int y = 0; y < dstHeight; ++y) {
+        const int y0 = std::min(2 * y, height - 1);
+        const int y1 = std::min(2 * y + 1, height - 1);
+        for (int x = 0; x < dstWidth; ++x) {
+            const int x0 = std::min(2 * x, width - 1);
+            const int x1 = std::min(2 * x + 1, width - 1);
+            for (int c = 0; c < 4; ++c) {
+                const int sum = src[((size_t)y0 * width + x0) * 4 + c] + src[((size_t)y0 * width + x1) * 4 + c] +
+                                src[((size_t)y1 * width + x0) * 4 + c] + src[((size_t)y1 * width + x1) * 4 + c];
+                dst[((size_t)y * dstWidth + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+static uint16_t toRgb565(const int color[3]) {
+    const int r = (color[0] * 31 + 127) / 255;
+    const int g = (color[1] * 63 + 127) / 255;
+    const int b = (color[2] * 31 + 127) / 255;
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void fromRgb565(uint16_t packed, int color[3]) {
+    const int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// 4x4画素 (RGBA8) を1ブロックに圧縮する. 端点は色の範囲の対角線を少し内側に寄せたもの
+// Compress 4x4 RGBA8 pixels into one BC1 block. The endpoints are the colour bounding
+// box diagonal (oriented by its correlation with green), inset slightly.
+static void encodeBC1Block(const unsigned char pixels[16][4], unsigned char out[8]) {
+    int lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            lo[c] = std::min(lo[c], (int)pixels[i][c]);
+            hi[c] = std::max(hi[c], (int)pixels[i][c]);
+            mean[c] += pixels[i][c] / 16.0f;
+        }
+    }
+
+    // 緑と逆向きに変わる成分は端点を入れ替える / Flip channels that fall as green rises
+    float covRG = 0.0f, covBG = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+        const float dg = pixels[i][1] - mean[1];
+        covRG += (pixels[i][0] - mean[0]) * dg;
+        covBG += (pixels[i][2] - mean[2]) * dg;
+    }
+    int c0[3] = { hi[0], hi[1], hi[2] }, c1[3] = { lo[0], lo[1], lo[2] };
+    if (covRG < 0.0f) std::swap(c0[0], c1[0]);
+    if (covBG < 0.0f) std::swap(c0[2], c1[2]);
+    for (int c = 0; c < 3; ++c) {
+        const int inset = (c0[c] - c1[c]) / 16;
+        c0[c] -= inset;
+        c1[c] += inset;
+    }
+
+    // 4色モードにはcolor0 > color1が必要 / 4-colour mode needs color0 > color1
+    uint16_t e0 = toRgb565(c0), e1 = toRgb565(c1);
+    if (e0 < e1) std::swap(e0, e1);
+
+    uint32_t indices = 0;
+    if (e0 != e1) {
+        int palette[4][3];
+        fromRgb565(e0, palette[0]);
+        fromRgb565(e1, palette[1]);
+        for (int c = 0; c < 3; ++c) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; ++i) {
+            int best = 0, bestDist = 1 << 30;
+            for (int p = 0; p < 4; ++p) {
+                int dist = 0;
+                for (int c = 0; c < 3; ++c) {
+                    const int d = pixels[i][c] - palette[p][c];
+                    dist += d * d;
+                }
+                if (dist < bestDist) {
+                    bestDist = dist;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (2 * i);
+        }
+    }
+
+    out[0] = (unsigned char)(e0 & 0xFF);
+    out[1] = (unsigned char)(e0 >> 8);
+    out[2] = (unsigned char)(e1 & 0xFF);
+    out[3] = (unsigned char)(e1 >> 8);
+    for (int i = 0; i < 4; ++i) out[4 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+static void encodeBC1(const unsigned char *src, int width, int height, unsigned char *dst) {
+    unsigned char block[16][4];
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            // 端のブロックは最後の画素を繰り返す / Edge blocks repeat the last pixel
+            for (int i = 0; i < 16; ++i) {
+                const int x = std::min(bx + i % 4, width - 1);
+                const int y = std::min(by + i / 4, height - 1);
+                std::memcpy(block[i], src + ((size_t)y * width + x) * 4, 4);
+            }
+            encodeBC1Block(block, dst);
+            dst += 8;
+        }
+    }
+}
+
+CachedTexture TextureCache::build(const LoadedImage &image, GLenum format) {
+    CachedTexture texture;
+    if (!image.valid()) return texture;
+    texture.format = format;
+    texture.width = image.width;
+    texture.height = image.height;
+
+    // 全段を1つのバッファに並べる / All levels share one buffer
+    const int levelCount = mipLevelCount(image.width, image.height);
+    std::vector<size_t> offsets(levelCount);
+    size_t total = 0;
+    for (int i = 0, w = image.width, h = image.height; i < levelCount; ++i) {
+        offsets[i] = total;
+        total = alignOffset(total + levelSize(format, w, h));
+        w = std::max(1, w / 2);
+        h = std::max(1, h / 2);
+    }
+    auto buffer = std::make_shared<std::vector<unsigned char>>(total);
+
+    std::vector<unsigned char> current = image.pixels, next;
+    int w = image.width, h = image.height;
+    for (int i = 0; i < levelCount; ++i) {
+        unsigned char *dst = buffer->data() + offsets[i];
+        if (format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) {
+            encodeBC1(current.data(), w, h, dst);
+        } else {
+            std::memcpy(dst, current.data(), current.size());
+        }
+        texture.levels.push_back({ w, h, dst, levelSize(format, w, h) });
+
+        if (i + 1 < levelCount) {
+            const int nw = std::max(1, w / 2), nh = std::max(1, h / 2);
+            next.resize((size_t)nw * nh * 4);
+            downsample(current.data(), w, h, next.data(), nw, nh);
+            current.swap(next);
+            w = nw;
+            h = nh;
+        }
+    }
+    texture.storage = buffer;
+    return texture;
+}
+
+// ---------------------------------------------------------------------------
+// TextureCache
+// ---------------------------------------------------------------------------
+
+TextureCache::TextureCache(std::string directory)
+    : directory_(std::move(directory)) {
+}
+
+void TextureCache::detectCompression() {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    compression_ = false;
+    for (GLint i = 0; i < count; ++i) {
+        const char *name = (const char *)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+        if (name && std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0) {
+            compression_ = true;
+            break;
+        }
+    }
+}
+
+GLenum TextureCache::opaqueFormat() const {
+    return compression_ ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_RGBA8;
+}
+
+std::string TextureCache::cacheFile(const std::string &sourcePath, const std::string &variant, bool opaque) const {
+    const std::string key = sourcePath + "|" + variant + (opaque ? "|opaque" : "");
+    char name[32];
+    snprintf(name, sizeof(name), "tex_%016llx.bin", (unsigned long long)fnv1a(key.data(), key.size()));
+    return directory_ + name;
+}
+
+CachedTexture TextureCache::fetch(const std::string &sourcePath, const Asset &source, const std::string &variant,
+                                  bool opaque, const Decoder &decode) const {
+    if (!source.valid()) return CachedTexture();
+    const int64_t time = source.time;
+    const uint64_t size = source.size;
+    const std::string path = cacheFile(sourcePath, variant, opaque);
+
+    // 内容のハッシュはパックに入っていればそれを使い, 無ければ必要になった時に計算する
+    // The content hash comes from the pack when present and is computed on demand otherwise
+    uint64_t hash = source.hash;
+    auto sourceHash = [&]() {
+        if (hash == 0) hash = fnv1a(source.data, source.size);
+        return hash;
+    };
+
+    // キャッシュを調べる / Try the cache
+    size_t mappedSize = 0;
+    if (auto mapped = mapFile(path, mappedSize)) {
+        const unsigned char *base = (const unsigned char *)mapped.get();
+        TextureCacheHeader header;
+        bool ok = mappedSize >= sizeof(header);
+        if (ok) {
+            std::memcpy(&header, base, sizeof(header));
+            ok = std::memcmp(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+                 header.compression == (compression_ ? 1u : 0u) &&
+                 (header.format == GL_RGBA8 || header.format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) &&
+                 header.width > 0 && header.height > 0 &&
+                 header.levelCount == mipLevelCount(header.width, header.height) &&
+                 mappedSize >= sizeof(header) + header.levelCount * sizeof(TextureCacheLevel);
+        }
+        // 更新時刻が違っても内容が同じなら使える. その時はヘッダの時刻を新しくし,
+        // 次回からは元画像を読んでハッシュを計算しないで済むようにする
+        // A touched but unchanged source still hits; the header then gets the new time so
+        // later runs do not have to read and hash the source again
+        const bool touched = ok && (header.sourceTime != time || header.sourceSize != size);
+        if (touched) ok = header.sourceHash == sourceHash();
+        if (ok) {
+            CachedTexture texture;
+            texture.format = header.format;
+            texture.width = header.width;
+            texture.height = header.height;
+            const TextureCacheLevel *table = (const TextureCacheLevel *)(base + sizeof(header));
+            for (int i = 0, w = header.width, h = header.height; ok && i < header.levelCount; ++i) {
+                ok = table[i].size == levelSize(header.format, w, h) &&
+                     table[i].offset + table[i].size <= mappedSize;
+                texture.levels.push_back({ w, h, base + table[i].offset, (size_t)table[i].size });
+                w = std::max(1, w / 2);
+                h = std::max(1, h / 2);
+            }
+            if (ok) {
+                if (touched) updateSourceStamp(path, time, size);
+                texture.storage = mapped;
+                return texture;
+            }
+        }
+    }
+
+    // 作り直す / Rebuild
+    LoadedImage image = decode();
+    if (!image.valid()) return CachedTexture();
+
+    GLenum format = GL_RGBA8;
+    if (compression_) {
+        bool transparent = false;
+        if (!opaque) {
+            for (size_t i = 3; i < image.pixels.size() && !transparent; i += 4) transparent = image.pixels[i] != 255;
+        }
+        if (!transparent) format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    }
+    CachedTexture texture = build(image, format);
+    sourceHash();
+
+    // 途中で止まっても壊れたファイルが残らないよう, 一時ファイルに書いてから置き換える
+    // Write to a temporary file and rename, so an interrupted write never leaves a broken entry
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+    const std::string temp = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    {
+        std::ofstream writer(temp, std::ios::binary);
+        if (!writer.is_open()) {
+            fprintf(stderr, "Failed to write texture cache: %s\n", path.c_str());
+            return texture;
+        }
+        TextureCacheHeader header = {};
+        std::memcpy(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic));
+        header.format = texture.format;
+        header.compression = compression_ ? 1u : 0u;
+        header.width = texture.width;
+        header.height = texture.height;
+        header.levelCount = (int32_t)texture.levels.size();
+        header.sourceTime = time;
+        header.sourceSize = size;
+        header.sourceHash = hash;
+        writer.write((const char *)&header, sizeof(header));
+
+        std::vector<TextureCacheLevel> table(texture.levels.size());
+        size_t offset = alignOffset(sizeof(header) + table.size() * sizeof(TextureCacheLevel));
+        for (size_t i = 0; i < table.size(); ++i) {
+            table[i] = { offset, texture.levels[i].size };
+            offset = alignOffset(offset + texture.levels[i].size);
+        }
+        writer.write((const char *)table.data(), (std::streamsize)(table.size() * sizeof(TextureCacheLevel)));
+
+        const char padding[16] = {};
+        size_t written = sizeof(header) + table.size() * sizeof(TextureCacheLevel);
+        for (size_t i = 0; i < table.size(); ++i) {
+            writer.write(padding, (std::streamsize)(table[i].offset - written));
+            writer.write((const char *)texture.levels[i].data, (std::streamsize)texture.levels[i].size);
+            written = table[i].offset + table[i].size;
+        }
+        if (!writer) {
+            fprintf(stderr, "Failed to write texture cache: %s\n", path.c_str());
+            writer.close();
+            std::filesystem::remove(temp, ec);
+            return texture;
+        }
+    }
+    std::filesystem::rename(temp, path, ec);
+    if (ec) std::filesystem::remove(temp, ec);
+    return texture;
+}
+
+// ---------------------------------------------------------------------------
+// 転送 / Upload
+// ---------------------------------------------------------------------------
+
+void uploadTexture2D(const CachedTexture &texture) {
+    for (size_t i = 0; i < texture.levels.size(); ++i) {
+        const CachedTexture::Level &level = texture.levels[i];
+        if (texture.compressed()) {
+            glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, texture.format, level.width, level.height, 0,
+                                   (GLsizei)level.size, level.data);
+        } else {
+            glTexImage2D(GL_TEXTURE_2D, (GLint)i, GL_RGBA8, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                         level.data);
+        }
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)texture.levels.size() - 1);
+}
+
+void allocateTextureArray(GLenum format, int width, int height, int layers) {
+    const int levelCount = mipLevelCount(width, height);
+    for (int i = 0; i < levelCount; ++i) {
+        if (format == GL_RGBA8) {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, i, GL_RGBA8, width, height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        } else {
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, i, format, width, height, layers, 0,
+                                   (GLsizei)(levelSize(format, width, height) * layers), NULL);
+        }
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+}
+
+void uploadTextureLayer(const CachedTexture &texture, int layer) {
+    for (size_t i = 0; i < texture.levels.size(); ++i) {
+        const CachedTexture::Level &level = texture.levels[i];
+        if (texture.compressed()) {
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)i, 0, 0, layer, level.width, level.height, 1,
+                                      texture.format, (GLsizei)level.size, level.data);
+        } else {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)i, 0, 0, layer, level.width, level.height, 1, GL_RGBA,
+                            GL_UNSIGNED_BYTE, level.data);
+        }
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef _TEXTURE_CACHE_H_
+#define _TEXTURE_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "asset_pack.h"
+#include "image_loader.h"
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+// 転送できる形になったテクスチャ (ミップマップ込み). 中身はキャッシュファイルを
+// マップしたメモリか, 作ったばかりのバッファを指す
+// Texture ready for upload, mip chain included. Its levels point either into a
+// memory-mapped cache file or into a freshly built buffer.
+struct CachedTexture {
+    struct Level {
+        int width;
+        int height;
+        const unsigned char *data;
+        size_t size;
+    };
+
+    GLenum format = GL_RGBA8;  // GL_RGBA8 か GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+    int width = 0;
+    int height = 0;
+    std::vector<Level> levels;
+    std::shared_ptr<const void> storage;  // levelsの中身を生かしておく / Keeps the level data alive
+
+    bool valid() const { return !levels.empty(); }
+    bool compressed() const { return format != GL_RGBA8; }
+};
+
+// 画像から作ったテクスチャをディスクに保存しておくキャッシュ
+// 元画像のパス・更新時刻・内容のハッシュで引き, 一致すればデコードもミップマップ生成もせず
+// ファイルをマップしたまま返す. 一致しなければ作り直して保存する.
+// 不透明な画像はBC1 (S3TC DXT1) に圧縮する (RGBA8の1/8). 使えない環境ではRGBA8のまま
+// Disk cache of textures built from images. Entries are keyed by source path,
+// modification time and content hash; on a hit the file is mapped and returned with
+// no decoding and no mip generation, on a miss the texture is rebuilt and stored.
+// Opaque images are compressed to BC1 (S3TC DXT1, 1/8 of RGBA8) when the driver
+// supports it, and kept as RGBA8 otherwise.
+class TextureCache {
+public:
+    // キャッシュが使えない時だけ呼ばれる, 元画像をRGBA8にする処理
+    // Produces the RGBA8 source image; only called on a cache miss
+    using Decoder = std::function<LoadedImage()>;
+
+    explicit TextureCache(std::string directory);
+
+    // BC1が使えるか (GLスレッドで読み込みを始める前に一度呼ぶ)
+    // Whether BC1 can be used; call once on the GL thread before any fetch
+    void detectCompression();
+    bool compressionSupported() const { return compression_; }
+
+    // opaqueなテクスチャが使う形式 (配列テクスチャを先に確保するため)
+    // Format used for opaque textures (so an array texture can be allocated up front)
+    GLenum opaqueFormat() const;
+
+    // sourcePathのテクスチャを返す. sourceはその中身 (時刻・大きさ・ハッシュで古さを調べる).
+    // variantは同じ画像から作る別の物 (大きさなど) を区別する.
+    // opaqueならアルファを捨てて必ず圧縮する. どのスレッドからでも呼べる
+    // Return the texture for sourcePath; source holds its contents (its time, size and hash
+    // decide whether the cache is stale). variant tells apart different products of the
+    // same image (e.g. sizes). opaque drops alpha so the texture is always compressed.
+    // Callable from any thread.
+    CachedTexture fetch(const std::string &sourcePath, const Asset &source, const std::string &variant, bool opaque,
+                        const Decoder &decode) const;
+
+    // RGBA8の画像からミップマップを作り, 必要なら圧縮する
+    // Build the mip chain of an RGBA8 image, compressing it if requested
+    static CachedTexture build(const LoadedImage &image, GLenum format);
+
+private:
+    std::string cacheFile(const std::string &sourcePath, const std::string &variant, bool opaque) const;
+
+    std::string directory_;
+    bool compression_ = false;
+};
+
+// ミップマップの段数 (1x1まで) / Number of mip levels down to 1x1
+int mipLevelCount(int width, int height);
+
+// バインド中のGL_TEXTURE_2Dに全段を転送する / Upload every level to the bound GL_TEXTURE_2D
+void uploadTexture2D(const CachedTexture &texture);
+
+// バインド中のGL_TEXTURE_2D_ARRAYを全段確保する / Allocate every level of the bound GL_TEXTURE_2D_ARRAY
+void allocateTextureArray(GLenum format, int width, int height, int layers);
+
+// バインド中のGL_TEXTURE_2D_ARRAYのlayerに全段を転送する
+// Upload every level into one layer of the bound GL_TEXTURE_2D_ARRAY
+void uploadTextureLayer(const CachedTexture &texture, int layer);
+
+#endif  // _TEXTURE_CACHE_H_